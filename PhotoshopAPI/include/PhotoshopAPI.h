@@ -8,6 +8,7 @@ in the PhotoshopAPI repository.
 
 #include "Macros.h"
 #include "PhotoshopFile/PhotoshopFile.h"
+#include "PhotoshopFile/PsdReader.h"
 #include "LayeredFile/LayeredFile.h"
 #include "LayeredFile/LayerTypes/ImageLayer.h"
 #include "LayeredFile/LayerTypes/GroupLayer.h"
@@ -56,6 +56,53 @@ inline void DecompressData(ByteStream& stream, std::span<T> buffer, uint64_t off
 }
 
 
+/// Read and decompress only a rectangular region of a single channel directly from the source into the buffer which must
+/// hold at least region.width * region.height elements, the data is endian decoded into native encoding. Raw and RLE
+/// channels only read the rows covered by the region while zip compressed channels have to be inflated in full.
+///
+/// The offset points to the start of the compressed data, i.e. past the compression marker of the channel. For RLE 
+/// channels the scanline offsets may be passed in (see RLE_Impl::ReadScanlineOffsets) when reading many regions of 
+/// the same channel, otherwise they are read for every region
+/// ---------------------------------------------------------------------------------------------------------------------
+/// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+inline void DecompressDataRegion(ByteSource& source, std::span<T> buffer, uint64_t offset, const Enum::Compression& compression, const FileHeader& header, const uint32_t width, const uint32_t height, const uint64_t compressedSize, const ChannelRegion region, std::span<const uint64_t> scanlineOffsets = {})
+{
+	PROFILE_FUNCTION();
+	switch (compression)
+	{
+	case Enum::Compression::Rle:
+		DecompressRLERegion<T>(source, buffer, offset, header, width, height, compressedSize, region, scanlineOffsets);
+		break;
+	case Enum::Compression::Zip:
+		DecompressZIPRegion<T>(source, buffer, offset, width, height, compressedSize, region);
+		break;
+	case Enum::Compression::ZipPrediction:
+		DecompressZIPPredictionRegion<T>(source, buffer, offset, width, height, compressedSize, region);
+		break;
+	default:
+	{
+		validateRegion("DecompressData", buffer, width, height, region);
+		if (offset + static_cast<uint64_t>(width) * height * sizeof(T) > source.size() || static_cast<uint64_t>(width) * height * sizeof(T) > compressedSize)
+		{
+			PSAPI_LOG_ERROR("DecompressData", "Raw channel data of %" PRIu64 " bytes at offset %" PRIu64 " lies outside of the source", compressedSize, offset);
+		}
+		// Raw rows are addressable directly so we read just the columns of the region for every row
+		std::vector<ByteSource::ReadRequest> requests(region.height);
+		for (uint64_t y = 0; y < region.height; ++y)
+		{
+			requests[y].buffer = reinterpret_cast<char*>(buffer.data() + y * region.width);
+			requests[y].offset = offset + ((region.y + y) * width + region.x) * sizeof(T);
+			requests[y].size = static_cast<uint64_t>(region.width) * sizeof(T);
+		}
+		source.readBatch(requests);
+		endianDecodeBEArray(std::span<T>(buffer.data(), static_cast<uint64_t>(region.width) * region.height));
+		break;
+	}
+	}
+}
+
+
 // Compress an input datastream using the appropriate compression algorithm while encoding to BE order
 // RLE compression will encode the scanline sizes at the start of the data as well. This would equals to 
 // 2/4 * height bytes of additional data (2 bytes for PSD and 4 for PSB)
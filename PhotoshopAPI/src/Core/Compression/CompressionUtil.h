@@ -1,5 +1,16 @@
 #pragma once
 
+#include "Macros.h"
+#include "Logger.h"
+#include "CoordinateUtil.h"
+
+#include <span>
+#include <tuple>
+#include <vector>
+
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
 
 PSAPI_NAMESPACE_BEGIN
 
@@ -42,4 +53,25 @@ inline std::vector<uint32_t> createVerticalImageIterator(const uint32_t height)
 	return verticalIter;
 }
 
+// Check that the region lies within a channel of the given size and that the buffer is large enough to hold it,
+// throwing otherwise
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+void validateRegion(const char* caller, std::span<T> buffer, const uint32_t width, const uint32_t height, const ChannelRegion region)
+{
+	const uint64_t regionSize = static_cast<uint64_t>(region.width) * region.height;
+	if (buffer.size() < regionSize)
+	{
+		PSAPI_LOG_ERROR(caller, "Provided buffer is not large enough. Expected at least: %" PRIu64 " but got %zu instead",
+			regionSize,
+			buffer.size());
+	}
+	if (!region.fitsWithin(width, height))
+	{
+		PSAPI_LOG_ERROR(caller, "Region of %" PRIu32 "x%" PRIu32 " at (%" PRIu32 ", %" PRIu32 ") does not fit within the channel of size %" PRIu32 "x%" PRIu32,
+			region.width, region.height, region.x, region.y, width, height);
+	}
+}
+
 PSAPI_NAMESPACE_END
\ No newline at end of file
@@ -8,10 +8,14 @@
 #include "Core/Struct/File.h"
 #include "Core/Struct/ByteStream.h"
 #include "PhotoshopFile/FileHeader.h"
+#include "CompressionUtil.h"
+#include "CoordinateUtil.h"
 #include "Profiling/Perf/Instrumentor.h"
 
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <execution>
 
 #include <cstring>
 #include <inttypes.h>
@@ -128,6 +132,83 @@ namespace RLE_Impl
         }
     }
 
+
+    // The number of decompressed bytes we aim for per band of scanlines that is decoded as a single task
+    constexpr uint64_t s_BandSize = 256 * 1024;
+
+
+    // Get the number of scanlines of the given size to decode as a single task such that each band holds roughly 
+    // s_BandSize bytes, this is at least a single scanline
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline uint32_t BandHeight(const uint64_t scanlineSize, const uint32_t height)
+    {
+        if (height == 0u)
+        {
+            return 0u;
+        }
+        if (scanlineSize == 0u)
+        {
+            return height;
+        }
+        return static_cast<uint32_t>(std::clamp<uint64_t>(s_BandSize / scanlineSize, 1u, height));
+    }
+
+
+    // Read the byte counts of the first numRows scanlines of an RLE compressed channel starting at offset and turn them 
+    // into the offsets of each scanline relative to the end of the byte counts. Holds numRows + 1 entries with the
+    // last one being the size of all of these scanlines
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline std::vector<uint64_t> ReadScanlineOffsets(ByteSource& source, const uint64_t offset, const FileHeader& header, const uint32_t numRows)
+    {
+        PROFILE_FUNCTION();
+        std::vector<uint64_t> scanlineOffsets(static_cast<uint64_t>(numRows) + 1u, 0u);
+        if (header.m_Version == Enum::Version::Psd)
+        {
+            std::vector<uint16_t> buff(numRows);
+            source.read(reinterpret_cast<char*>(buff.data()), offset, numRows * sizeof(uint16_t));
+            endianDecodeBEArray<uint16_t>(buff);
+            for (uint64_t i = 0; i < numRows; ++i)
+            {
+                scanlineOffsets[i + 1] = scanlineOffsets[i] + buff[i];
+            }
+        }
+        else
+        {
+            std::vector<uint32_t> buff(numRows);
+            source.read(reinterpret_cast<char*>(buff.data()), offset, numRows * sizeof(uint32_t));
+            endianDecodeBEArray<uint32_t>(buff);
+            for (uint64_t i = 0; i < numRows; ++i)
+            {
+                scanlineOffsets[i + 1] = scanlineOffsets[i] + buff[i];
+            }
+        }
+        return scanlineOffsets;
+    }
+
+
+    // Decompress the scanlines [rowBegin, rowEnd) of a channel into the buffer holding the whole channel and convert them
+    // to native endianness while they are still in cache. compressedOffsets holds the offset of every scanline of the 
+    // channel into compressedData as well as the end of the last scanline
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    template<typename T>
+    void DecompressScanlines(std::span<const uint8_t> compressedData, std::span<const uint64_t> compressedOffsets, std::span<T> buffer, const uint32_t width, const uint64_t rowBegin, const uint64_t rowEnd)
+    {
+        const uint64_t scanlineSize = static_cast<uint64_t>(width) * sizeof(T);
+        for (uint64_t y = rowBegin; y < rowEnd; ++y)
+        {
+            std::span<const uint8_t> compressedSpan(compressedData.data() + compressedOffsets[y], compressedOffsets[y + 1] - compressedOffsets[y]);
+            std::span<uint8_t> decompressedSpan(reinterpret_cast<uint8_t*>(buffer.data()) + y * scanlineSize, scanlineSize);
+#ifdef __AVX2__
+            DecompressPackBitsAVX2<T>(compressedSpan, decompressedSpan);
+#else
+            DecompressPackBits<T>(compressedSpan, decompressedSpan);
+#endif
+        }
+        endianDecodeBEArray(std::span<T>(buffer.data() + rowBegin * width, (rowEnd - rowBegin) * width));
+    }
 }
 
 
@@ -185,51 +266,121 @@ void DecompressRLE(ByteStream& stream, std::span<T> buffer, uint64_t offset, con
     }
 
     // Read the data without converting from BE to native as we need to decompress first
-    std::span<uint8_t> compressedData = stream.read(offset + SwapPsdPsb<uint16_t, uint32_t>(header.m_Version) * height, scanlineTotalSize);
+    std::span<const uint8_t> compressedData = stream.read(offset + SwapPsdPsb<uint16_t, uint32_t>(header.m_Version) * height, scanlineTotalSize);
 
-    // Generate spans for every individual scanline to decompress them individually
-    std::vector<std::span<const uint8_t>> compressedDataSpans(height);
-    std::vector<std::span<uint8_t>> decompressedDataSpans(height);
-    std::vector<unsigned int> verticalIter;
+    // The scanlines are independent of each other so we decode them in bands, each as its own task. This gives us enough
+    // tasks to keep every core busy on a single large channel while keeping their overhead low for tall channels. 
+    // Every band is converted to native endianness right after decompressing it while it is still in cache
+    std::vector<uint64_t> compressedOffsets(static_cast<uint64_t>(height) + 1u, 0u);
+    for (uint64_t i = 0; i < height; ++i)
     {
-        uint64_t compressedStartIdx = 0;
-        for (uint64_t i = 0; i < height; ++i)
+        compressedOffsets[i + 1] = compressedOffsets[i] + scanlineSizes[i];
+    }
+    const uint64_t scanlineSize = static_cast<uint64_t>(width) * sizeof(T);
+    const uint32_t bandHeight = RLE_Impl::BandHeight(scanlineSize, height);
+    std::vector<uint32_t> bandIter = createVerticalImageIterator(bandHeight == 0u ? 0u : (height + bandHeight - 1) / bandHeight);
+    auto decompressBand = [&](const uint32_t band)
         {
-            uint64_t compressedEndIdx = compressedStartIdx + scanlineSizes[i];
-            compressedDataSpans[i] = std::span<const uint8_t>(compressedData.begin() + compressedStartIdx, compressedData.begin() + compressedEndIdx);
-            compressedStartIdx = compressedEndIdx;
+            const uint64_t bandStart = static_cast<uint64_t>(band) * bandHeight;
+            const uint64_t bandEnd = std::min<uint64_t>(bandStart + bandHeight, height);
+            RLE_Impl::DecompressScanlines<T>(compressedData, compressedOffsets, buffer, width, bandStart, bandEnd);
+        };
+    {
+        PROFILE_SCOPE("DecompressPackBits");
+        // Decompress using the PackBits algorithm
+#ifdef __APPLE__
+        std::for_each(bandIter.begin(), bandIter.end(), decompressBand);
+#else
+        std::for_each(std::execution::par, bandIter.begin(), bandIter.end(), decompressBand);
+#endif
+    }
+}
 
-            uint64_t decompressedStartIdx = i * width * sizeof(T);
-            decompressedDataSpans[i] = std::span<uint8_t>(reinterpret_cast<uint8_t*>(buffer.data()) + decompressedStartIdx, width * sizeof(T));
 
-            verticalIter.push_back(i);
-        }
+// Reads and decompresses only the given region of a single RLE compressed channel directly from the source into the 
+// provided buffer which must hold at least region.width * region.height elements. As the scanline byte counts make every
+// row addressable we only read the rows covered by the region and crop the columns after unpacking each of them.
+// The offset points to the start of the scanline byte counts. If scanlineOffsets (as generated by 
+// RLE_Impl::ReadScanlineOffsets) is empty we read the byte counts up to the last row of the region ourselves
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template<typename T>
+void DecompressRLERegion(ByteSource& source, std::span<T> buffer, const uint64_t offset, const FileHeader& header, const uint32_t width, const uint32_t height, const uint64_t compressedSize, const ChannelRegion region, std::span<const uint64_t> scanlineOffsets = {})
+{
+    PROFILE_FUNCTION();
+    validateRegion("DecompressRLE", buffer, width, height, region);
+    const uint64_t regionSize = static_cast<uint64_t>(region.width) * region.height;
+    if (offset + compressedSize > source.size())
+    {
+        PSAPI_LOG_ERROR("DecompressRLE", "Compressed data of %" PRIu64 " bytes at offset %" PRIu64 " lies outside of the source", compressedSize, offset);
     }
+    if (regionSize == 0)
     {
-        PROFILE_SCOPE("DecompressPackBits");
-        // Decompress using the PackBits algorithm
-        #ifdef __APPLE__
-        std::for_each(verticalIter.begin(), verticalIter.end(), [&](auto index)
-            {
+        return;
+    }
+
+    const uint64_t countSize = SwapPsdPsb<uint16_t, uint32_t>(header.m_Version);
+    const uint32_t rowEnd = region.y + region.height;
+    if (countSize * height > compressedSize)
+    {
+        PSAPI_LOG_ERROR("DecompressRLE", "Compressed data of %" PRIu64 " bytes cannot hold the scanline sizes of %" PRIu32 " rows", compressedSize, height);
+    }
+    std::vector<uint64_t> readOffsets;
+    if (scanlineOffsets.empty())
+    {
+        readOffsets = RLE_Impl::ReadScanlineOffsets(source, offset, header, rowEnd);
+        scanlineOffsets = readOffsets;
+    }
+    if (scanlineOffsets.size() <= rowEnd)
+    {
+        PSAPI_LOG_ERROR("DecompressRLE", "Expected the offsets of at least %" PRIu32 " scanlines but only got %zu", rowEnd, scanlineOffsets.size() - 1);
+    }
+
+    // Offsets of the rows of the region relative to the first of them
+    const uint64_t dataOffset = offset + countSize * height + scanlineOffsets[region.y];
+    std::vector<uint64_t> rowOffsets(static_cast<uint64_t>(region.height) + 1u, 0u);
+    for (uint32_t y = 0; y <= region.height; ++y)
+    {
+        rowOffsets[y] = scanlineOffsets[region.y + y] - scanlineOffsets[region.y];
+    }
+    if (dataOffset + rowOffsets.back() > offset + compressedSize)
+    {
+        PSAPI_LOG_ERROR("DecompressRLE", "Size of compressed data is smaller than the scanline sizes indicate, expected at least %" PRIu64 " bytes but got %" PRIu64 " instead",
+            dataOffset + rowOffsets.back() - offset,
+            compressedSize);
+    }
+
+    // Read the data without converting from BE to native as we need to decompress first
+    std::vector<uint8_t> compressedData(rowOffsets.back());
+    source.read(reinterpret_cast<char*>(compressedData.data()), dataOffset, compressedData.size());
+
+    std::vector<uint32_t> verticalIter = createVerticalImageIterator(region.height);
+    const uint64_t scanlineSize = static_cast<uint64_t>(width) * sizeof(T);
+    const uint64_t regionScanlineSize = static_cast<uint64_t>(region.width) * sizeof(T);
+    uint8_t* bufferData = reinterpret_cast<uint8_t*>(buffer.data());
+    auto decompressRow = [&](const uint32_t y)
+        {
+            // Every row is unpacked in full as PackBits runs may span the region boundaries
+            std::vector<uint8_t> scanline(scanlineSize);
+            std::span<const uint8_t> compressedSpan(compressedData.data() + rowOffsets[y], rowOffsets[y + 1] - rowOffsets[y]);
 #ifdef __AVX2__
-                RLE_Impl::DecompressPackBitsAVX2<T>(compressedDataSpans[index], decompressedDataSpans[index]);
+            RLE_Impl::DecompressPackBitsAVX2<T>(compressedSpan, scanline);
 #else
-                RLE_Impl::DecompressPackBits<T>(compressedDataSpans[index], decompressedDataSpans[index]);
+            RLE_Impl::DecompressPackBits<T>(compressedSpan, scanline);
 #endif
-            });
-            #else
-            std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), [&](auto index)
-            {
-#ifdef __AVX2__
-                RLE_Impl::DecompressPackBitsAVX2<T>(compressedDataSpans[index], decompressedDataSpans[index]);
+            std::memcpy(bufferData + y * regionScanlineSize, scanline.data() + static_cast<uint64_t>(region.x) * sizeof(T), regionScanlineSize);
+        };
+    {
+        PROFILE_SCOPE("DecompressPackBits");
+#ifdef __APPLE__
+        std::for_each(verticalIter.begin(), verticalIter.end(), decompressRow);
 #else
-                RLE_Impl::DecompressPackBits<T>(compressedDataSpans[index], decompressedDataSpans[index]);
+        std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), decompressRow);
 #endif
-            });
-            #endif
     }
+
     // Convert decompressed data to native endianness in-place
-    endianDecodeBEArray(buffer);
+    endianDecodeBEArray(std::span<T>(buffer.data(), regionSize));
 }
 
 
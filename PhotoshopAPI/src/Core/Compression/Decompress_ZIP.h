@@ -5,6 +5,7 @@
 #include "Core/Endian/EndianByteSwap.h"
 #include "Core/Endian/EndianByteSwapArr.h"
 #include "CompressionUtil.h"
+#include "CoordinateUtil.h"
 #include "Core/Struct/ByteStream.h"
 #include "Profiling/Perf/Instrumentor.h"
 
@@ -36,7 +37,7 @@ namespace ZIP_Impl
 	// ---------------------------------------------------------------------------------------------------------------------
 	// ---------------------------------------------------------------------------------------------------------------------
 	template <typename T>
-	void Decompress(const std::span<uint8_t> compressedData, std::span<T> buffer, const uint64_t decompressedSize)
+	void Decompress(const std::span<const uint8_t> compressedData, std::span<T> buffer, const uint64_t decompressedSize)
 	{
 		PROFILE_FUNCTION();
 
@@ -157,6 +158,111 @@ namespace ZIP_Impl
 		std::memcpy(reinterpret_cast<char*>(decompressedData.data()), reinterpret_cast<char*>(deinterleavedData.data()), deinterleavedData.size() * sizeof(float32_t));
 	}
 
+
+	// Read and inflate the compressed data of a whole channel from the source. Inflate streams have no random access and
+	// libdeflate only decompresses whole buffers so this is needed even if only a region of the channel is of interest.
+	// The returned data is still in BE order
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	std::vector<T> InflateChannel(ByteSource& source, const uint64_t offset, const uint32_t width, const uint32_t height, const uint64_t compressedSize)
+	{
+		PROFILE_FUNCTION();
+		if (offset + compressedSize > source.size())
+		{
+			PSAPI_LOG_ERROR("UnZip", "Compressed data of %" PRIu64 " bytes at offset %" PRIu64 " lies outside of the source", compressedSize, offset);
+		}
+		std::vector<uint8_t> compressedData(compressedSize);
+		source.read(reinterpret_cast<char*>(compressedData.data()), offset, compressedSize);
+
+		std::vector<T> decompressedData(static_cast<uint64_t>(width) * height);
+		Decompress<T>(compressedData, std::span<T>(decompressedData), decompressedData.size());
+		return decompressedData;
+	}
+
+
+	// Copy the given region out of the inflated (but still BE encoded) channel into the buffer while converting to native
+	// endianness
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	void CopyRegion(std::span<T> decompressedData, std::span<T> buffer, const uint32_t width, const ChannelRegion region)
+	{
+		PROFILE_FUNCTION();
+		for (uint64_t y = 0; y < region.height; ++y)
+		{
+			const uint8_t* row = reinterpret_cast<const uint8_t*>(decompressedData.data() + (region.y + y) * width);
+			for (uint64_t x = 0; x < region.width; ++x)
+			{
+				buffer[y * region.width + x] = endianDecodeBE<T>(row + (region.x + x) * sizeof(T));
+			}
+		}
+	}
+
+
+	// Reverse the prediction encoding for only the rows covered by the given region and copy the region into the buffer
+	// while converting to native endianness. As the prediction runs across the whole row every row is decoded up to 
+	// the right edge of the region
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	void RemovePredictionEncodingRegion(std::span<T> decompressedData, std::span<T> buffer, const uint32_t width, const ChannelRegion region)
+	{
+		PROFILE_FUNCTION();
+		std::vector<uint32_t> verticalIter = createVerticalImageIterator(region.height);
+		auto decodeRow = [&](const uint32_t y)
+			{
+				const uint8_t* row = reinterpret_cast<const uint8_t*>(decompressedData.data() + (static_cast<uint64_t>(region.y) + y) * width);
+				T value = 0;
+				for (uint64_t x = 0; x < static_cast<uint64_t>(region.x) + region.width; ++x)
+				{
+					// Simple differencing: decode by adding the difference to the previous value
+					value += endianDecodeBE<T>(row + x * sizeof(T));
+					if (x >= region.x)
+					{
+						buffer[static_cast<uint64_t>(y) * region.width + x - region.x] = value;
+					}
+				}
+			};
+#ifdef __APPLE__
+		std::for_each(verticalIter.begin(), verticalIter.end(), decodeRow);
+#else
+		std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), decodeRow);
+#endif
+	}
+
+
+	// As with the full channel, 32-bit data has its bytes de-interleaved per row (1111 2222 3333 4444) so the bytewise 
+	// differencing has to be undone for the whole row before we can gather the bytes of the columns in the region
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <>
+	inline void RemovePredictionEncodingRegion(std::span<float32_t> decompressedData, std::span<float32_t> buffer, const uint32_t width, const ChannelRegion region)
+	{
+		PROFILE_FUNCTION();
+		std::vector<uint32_t> verticalIter = createVerticalImageIterator(region.height);
+		auto decodeRow = [&](const uint32_t y)
+			{
+				// The rows are independent of each other so we can decode them in-place
+				uint8_t* row = reinterpret_cast<uint8_t*>(decompressedData.data() + (static_cast<uint64_t>(region.y) + y) * width);
+				for (uint64_t x = 1; x < static_cast<uint64_t>(width) * sizeof(float32_t); ++x)
+				{
+					row[x] += row[x - 1];
+				}
+				for (uint64_t x = 0; x < region.width; ++x)
+				{
+					const uint64_t column = static_cast<uint64_t>(region.x) + x;
+					const uint8_t bytes[4] = { row[column], row[width + column], row[static_cast<uint64_t>(width) * 2 + column], row[static_cast<uint64_t>(width) * 3 + column] };
+					buffer[static_cast<uint64_t>(y) * region.width + x] = endianDecodeBE<float32_t>(bytes);
+				}
+			};
+#ifdef __APPLE__
+		std::for_each(verticalIter.begin(), verticalIter.end(), decodeRow);
+#else
+		std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), decodeRow);
+#endif
+	}
+
 }
 
 
@@ -169,7 +275,7 @@ void DecompressZIP(ByteStream& stream, std::span<T> buffer, uint64_t offset, con
 {
 	PROFILE_FUNCTION();
 	// Read the data without converting from BE to native as we need to decompress first
-	std::span<uint8_t> compressedData = stream.read(offset, compressedSize);
+	std::span<const uint8_t> compressedData = stream.read(offset, compressedSize);
 
 	// Decompress using Inflate ZIP into the buffer
 	ZIP_Impl::Decompress<T>(compressedData, buffer, static_cast<uint64_t>(width) * height);
@@ -206,7 +312,7 @@ void DecompressZIPPrediction(ByteStream& stream, std::span<T> buffer, uint64_t o
 {
 	PROFILE_FUNCTION();
 	// Read the data without converting from BE to native as we need to decompress first
-	std::span<uint8_t> compressedData = stream.read(offset, compressedSize);
+	std::span<const uint8_t> compressedData = stream.read(offset, compressedSize);
 
 	// Decompress using Inflate ZIP into the buffer
 	ZIP_Impl::Decompress<T>(compressedData, buffer, static_cast<uint64_t>(width) * height);
@@ -235,6 +341,43 @@ std::vector<T> DecompressZIPPrediction(std::vector<uint8_t>& compressedData, con
 	return decompressedData;
 }
 
+// Decompress only the given region of a zip compressed channel from the source into the buffer which must hold at least 
+// region.width * region.height elements. The whole channel has to be inflated but only the region gets endian decoded
+// and copied out. The offset points to the start of the compressed data
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+void DecompressZIPRegion(ByteSource& source, std::span<T> buffer, const uint64_t offset, const uint32_t width, const uint32_t height, const uint64_t compressedSize, const ChannelRegion region)
+{
+	PROFILE_FUNCTION();
+	validateRegion("DecompressZIP", buffer, width, height, region);
+	if (static_cast<uint64_t>(region.width) * region.height == 0)
+	{
+		return;
+	}
+	std::vector<T> decompressedData = ZIP_Impl::InflateChannel<T>(source, offset, width, height, compressedSize);
+	ZIP_Impl::CopyRegion<T>(decompressedData, buffer, width, region);
+}
+
+
+// Decompress only the given region of a zip compressed channel with prediction encoding from the source into the buffer 
+// which must hold at least region.width * region.height elements. The whole channel has to be inflated but only the 
+// rows covered by the region get their prediction encoding removed. The offset points to the start of the compressed data
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+void DecompressZIPPredictionRegion(ByteSource& source, std::span<T> buffer, const uint64_t offset, const uint32_t width, const uint32_t height, const uint64_t compressedSize, const ChannelRegion region)
+{
+	PROFILE_FUNCTION();
+	validateRegion("DecompressZIPPrediction", buffer, width, height, region);
+	if (static_cast<uint64_t>(region.width) * region.height == 0)
+	{
+		return;
+	}
+	std::vector<T> decompressedData = ZIP_Impl::InflateChannel<T>(source, offset, width, height, compressedSize);
+	ZIP_Impl::RemovePredictionEncodingRegion<T>(decompressedData, buffer, width, region);
+}
+
 
 
 PSAPI_NAMESPACE_END
\ No newline at end of file
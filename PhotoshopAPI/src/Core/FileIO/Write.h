@@ -68,6 +68,33 @@ void WriteBinaryArray(File& document, std::vector<T>&& data)
 }
 
 
+// Write data to the given offset in the file while encoding the data, this does not move the files' offset
+// marker and may be called from multiple threads as long as the regions written to do not overlap
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+template <typename T>
+void WriteBinaryDataToOffset(File& document, T data, const uint64_t offset)
+{
+	data = endianEncodeBE<T>(data);
+	std::span<const uint8_t> dataSpan(reinterpret_cast<uint8_t*>(&data), sizeof(T));
+	document.writeToOffset(dataSpan, offset);
+}
+
+
+// Write an array of data to the given offset in the file while endian encoding the values, this does not move 
+// the files' offset marker and may be called from multiple threads as long as the regions written to do not overlap
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+template <typename T>
+void WriteBinaryArrayToOffset(File& document, std::vector<T>&& data, const uint64_t offset)
+{
+	// Endian encode in-place
+	endianEncodeBEArray<T>(data);
+	std::span<const uint8_t> dataSpan(reinterpret_cast<uint8_t*>(data.data()), data.size() * sizeof(T));
+	document.writeToOffset(dataSpan, offset);
+}
+
+
 // Write a given amount of padding bytes with explicit zeroes
 // --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
@@ -0,0 +1,514 @@
+#include "ByteSink.h"
+
+#include "Profiling/Perf/Instrumentor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#define PSAPI_POSITIONAL_IO 1
+#elif defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+PSAPI_NAMESPACE_BEGIN
+
+
+namespace
+{
+	// Write the data to the given offset of the file descriptor, using pwrite where available and otherwise
+	// serializing the seek and write using the provided mutex
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	void writeToDescriptor(const int fileDescriptor, std::mutex& mutex, std::span<const uint8_t> data, const uint64_t offset)
+	{
+		PROFILE_FUNCTION();
+		uint64_t written = 0u;
+#ifdef PSAPI_POSITIONAL_IO
+		while (written < data.size())
+		{
+			ssize_t result = ::pwrite(fileDescriptor, data.data() + written, data.size() - written, static_cast<off_t>(offset + written));
+			if (result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (result < 0)
+			{
+				PSAPI_LOG_ERROR("ByteSink", "Failed to write %zu bytes to offset %" PRIu64 "", data.size(), offset);
+			}
+			written += static_cast<uint64_t>(result);
+		}
+#elif defined(_WIN32)
+		std::lock_guard<std::mutex> guard(mutex);
+		_lseeki64(fileDescriptor, static_cast<__int64>(offset), SEEK_SET);
+		while (written < data.size())
+		{
+			const unsigned int toWrite = static_cast<unsigned int>(std::min<uint64_t>(data.size() - written, (std::numeric_limits<int>::max)()));
+			int result = _write(fileDescriptor, data.data() + written, toWrite);
+			if (result < 0)
+			{
+				PSAPI_LOG_ERROR("ByteSink", "Failed to write %zu bytes to offset %" PRIu64 "", data.size(), offset);
+			}
+			written += static_cast<uint64_t>(result);
+		}
+#endif
+	}
+
+
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	void closeDescriptor(const int fileDescriptor)
+	{
+#ifdef PSAPI_POSITIONAL_IO
+		::close(fileDescriptor);
+#elif defined(_WIN32)
+		_close(fileDescriptor);
+#endif
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void FileByteSink::write(std::span<const uint8_t> data, const uint64_t offset)
+{
+	writeToDescriptor(m_FileDescriptor, m_Mutex, data, offset);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+FileByteSink::FileByteSink(const std::filesystem::path& file)
+{
+#ifdef PSAPI_POSITIONAL_IO
+	m_FileDescriptor = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#elif defined(_WIN32)
+	m_FileDescriptor = _wopen(file.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+	if (m_FileDescriptor < 0)
+	{
+		PSAPI_LOG_ERROR("FileByteSink", "Failed to open file: %s", file.string().c_str());
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+FileByteSink::~FileByteSink()
+{
+	if (m_FileDescriptor >= 0)
+	{
+		closeDescriptor(m_FileDescriptor);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MappedFileByteSink::write(std::span<const uint8_t> data, const uint64_t offset)
+{
+	PROFILE_FUNCTION();
+	const uint64_t end = offset + data.size();
+	if (data.empty())
+	{
+		return;
+	}
+
+	auto updateSize = [&]()
+	{
+		uint64_t size = m_Size.load();
+		while (size < end && !m_Size.compare_exchange_weak(size, end)) {}
+	};
+
+	{
+		std::shared_lock<std::shared_mutex> guard(m_Mutex);
+		if (end <= m_Capacity)
+		{
+			std::memcpy(m_Mapping.data() + offset, data.data(), data.size());
+			updateSize();
+			return;
+		}
+	}
+	std::unique_lock<std::shared_mutex> guard(m_Mutex);
+	if (end > m_Capacity)
+	{
+		// Grow geometrically to keep the amount of remaps low if we were not told the size up front
+		resize(std::max(end, m_Capacity * 2u));
+	}
+	std::memcpy(m_Mapping.data() + offset, data.data(), data.size());
+	updateSize();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MappedFileByteSink::flush()
+{
+	PROFILE_FUNCTION();
+	std::unique_lock<std::shared_mutex> guard(m_Mutex);
+	if (m_Mapping.is_mapped())
+	{
+		std::error_code error;
+		m_Mapping.sync(error);
+		if (error)
+		{
+			PSAPI_LOG_ERROR("MappedFileByteSink", "Failed to sync the mapping of file %s: %s", m_FilePath.string().c_str(), error.message().c_str());
+		}
+	}
+	// Trim any preallocated space we did not end up using
+	if (m_Capacity != m_Size)
+	{
+		resize(m_Size);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MappedFileByteSink::reserve(const uint64_t size)
+{
+	std::unique_lock<std::shared_mutex> guard(m_Mutex);
+	if (size > m_Capacity)
+	{
+		resize(size);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MappedFileByteSink::resize(const uint64_t capacity)
+{
+	PROFILE_FUNCTION();
+	// The file cannot be resized while mapped on all platforms so we always remap
+	m_Mapping.unmap();
+
+	bool preallocated = false;
+#if defined(__linux__)
+	if (capacity > m_Capacity)
+	{
+		// Unlike just extending the file this actually allocates the blocks which keeps the file contiguous on disk.
+		// Not every filesystem supports this in which case we fall back to a regular resize
+		preallocated = ::posix_fallocate(m_FileDescriptor, static_cast<off_t>(m_Capacity), static_cast<off_t>(capacity - m_Capacity)) == 0;
+	}
+#endif
+	if (!preallocated)
+	{
+		std::error_code error;
+		std::filesystem::resize_file(m_FilePath, capacity, error);
+		if (error)
+		{
+			PSAPI_LOG_ERROR("MappedFileByteSink", "Failed to resize file %s to %" PRIu64 " bytes: %s", m_FilePath.string().c_str(), capacity, error.message().c_str());
+		}
+	}
+	m_Capacity = capacity;
+
+	// Mapping an empty file is an error so we only map if there is anything to map
+	if (m_Capacity > 0)
+	{
+		std::error_code error;
+		m_Mapping.map(m_FilePath.string(), error);
+		if (error)
+		{
+			PSAPI_LOG_ERROR("MappedFileByteSink", "Failed to map file %s: %s", m_FilePath.string().c_str(), error.message().c_str());
+		}
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MappedFileByteSink::MappedFileByteSink(const std::filesystem::path& file)
+{
+	m_FilePath = file;
+#ifdef PSAPI_POSITIONAL_IO
+	m_FileDescriptor = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+#elif defined(_WIN32)
+	m_FileDescriptor = _wopen(file.c_str(), _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+	if (m_FileDescriptor < 0)
+	{
+		PSAPI_LOG_ERROR("MappedFileByteSink", "Failed to open file: %s", file.string().c_str());
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MappedFileByteSink::~MappedFileByteSink()
+{
+	// Unlike flush() we cannot throw here so any failures are only reported
+	try
+	{
+		flush();
+	}
+	catch (const std::exception& e)
+	{
+		PSAPI_LOG_WARNING("MappedFileByteSink", "Failed to finalize file %s: %s", m_FilePath.string().c_str(), e.what());
+	}
+	m_Mapping.unmap();
+	if (m_FileDescriptor >= 0)
+	{
+		closeDescriptor(m_FileDescriptor);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void DirectFileByteSink::write(std::span<const uint8_t> data, const uint64_t offset)
+{
+	PROFILE_FUNCTION();
+	if (data.empty())
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> guard(m_Mutex);
+
+	const uint64_t end = offset + data.size();
+	const uint64_t alignedStart = offset & ~(m_Alignment - 1u);
+	const uint64_t alignedEnd = (end + m_Alignment - 1u) & ~(m_Alignment - 1u);
+	for (uint64_t position = alignedStart; position < alignedEnd; position += m_StagingSize)
+	{
+		const uint64_t length = std::min(m_StagingSize, alignedEnd - position);
+		uint8_t* staging = m_Staging;
+
+		// Blocks only partially covered by the data have to keep their current contents
+		if (offset > position)
+		{
+			readBlock(staging, position);
+		}
+		if (end < position + length && (length > m_Alignment || offset <= position))
+		{
+			readBlock(staging + length - m_Alignment, position + length - m_Alignment);
+		}
+
+		const uint64_t copyStart = std::max(position, offset);
+		const uint64_t copyEnd = std::min(position + length, end);
+		std::memcpy(staging + (copyStart - position), data.data() + (copyStart - offset), copyEnd - copyStart);
+		writeToDescriptor(m_FileDescriptor, m_DescriptorMutex, std::span<const uint8_t>(staging, length), position);
+	}
+	m_Size = std::max(m_Size, end);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void DirectFileByteSink::readBlock(uint8_t* buffer, const uint64_t offset)
+{
+	std::memset(buffer, 0, m_Alignment);
+	if (offset >= m_Size)
+	{
+		return;
+	}
+#ifdef PSAPI_POSITIONAL_IO
+	uint64_t bytesRead = 0u;
+	while (bytesRead < m_Alignment)
+	{
+		ssize_t result = ::pread(m_FileDescriptor, buffer + bytesRead, m_Alignment - bytesRead, static_cast<off_t>(offset + bytesRead));
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result < 0)
+		{
+			PSAPI_LOG_ERROR("DirectFileByteSink", "Failed to read back block at offset %" PRIu64 "", offset);
+		}
+		// Anything past the current end of the file stays zeroed
+		if (result == 0)
+		{
+			break;
+		}
+		bytesRead += static_cast<uint64_t>(result);
+	}
+#elif defined(_WIN32)
+	_lseeki64(m_FileDescriptor, static_cast<__int64>(offset), SEEK_SET);
+	if (_read(m_FileDescriptor, buffer, static_cast<unsigned int>(m_Alignment)) < 0)
+	{
+		PSAPI_LOG_ERROR("DirectFileByteSink", "Failed to read back block at offset %" PRIu64 "", offset);
+	}
+#endif
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void DirectFileByteSink::flush()
+{
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	// We always write whole blocks so the file may extend past the data actually written
+#ifdef PSAPI_POSITIONAL_IO
+	if (::ftruncate(m_FileDescriptor, static_cast<off_t>(m_Size)) != 0)
+#elif defined(_WIN32)
+	if (_chsize_s(m_FileDescriptor, static_cast<__int64>(m_Size)) != 0)
+#endif
+	{
+		PSAPI_LOG_ERROR("DirectFileByteSink", "Failed to truncate the file to %" PRIu64 " bytes", m_Size);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+DirectFileByteSink::DirectFileByteSink(const std::filesystem::path& file, const uint64_t alignment, const uint64_t stagingSize)
+{
+	if (alignment == 0u || (alignment & (alignment - 1u)) != 0u)
+	{
+		PSAPI_LOG_ERROR("DirectFileByteSink", "The alignment must be a power of two, got %" PRIu64 "", alignment);
+	}
+	m_Alignment = alignment;
+	m_StagingSize = std::max((stagingSize + alignment - 1u) & ~(alignment - 1u), alignment);
+
+#if defined(__linux__)
+	m_FileDescriptor = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+	m_IsDirect = m_FileDescriptor >= 0;
+	if (!m_IsDirect)
+	{
+		// Some file systems such as tmpfs reject O_DIRECT
+		m_FileDescriptor = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	}
+#elif defined(PSAPI_POSITIONAL_IO)
+	m_FileDescriptor = ::open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	#ifdef F_NOCACHE
+	m_IsDirect = m_FileDescriptor >= 0 && ::fcntl(m_FileDescriptor, F_NOCACHE, 1) != -1;
+	#endif
+#elif defined(_WIN32)
+	m_FileDescriptor = _wopen(file.c_str(), _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+	if (m_FileDescriptor < 0)
+	{
+		PSAPI_LOG_ERROR("DirectFileByteSink", "Failed to open file: %s", file.string().c_str());
+	}
+	if (!m_IsDirect)
+	{
+		PSAPI_LOG_WARNING("DirectFileByteSink", "Direct I/O is not supported for file %s, falling back to cached writes", file.string().c_str());
+	}
+	m_Staging = static_cast<uint8_t*>(::operator new(m_StagingSize, std::align_val_t(m_Alignment)));
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+DirectFileByteSink::~DirectFileByteSink()
+{
+	if (m_FileDescriptor >= 0)
+	{
+		try
+		{
+			flush();
+		}
+		catch (const std::exception& e)
+		{
+			PSAPI_LOG_WARNING("DirectFileByteSink", "Failed to finalize file: %s", e.what());
+		}
+		closeDescriptor(m_FileDescriptor);
+	}
+	::operator delete(m_Staging, std::align_val_t(m_Alignment));
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MemoryByteSink::write(std::span<const uint8_t> data, const uint64_t offset)
+{
+	// Growing the buffer may reallocate so even non-overlapping writes have to be serialized
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	if (offset + data.size() > m_Data.size())
+	{
+		m_Data.resize(offset + data.size());
+	}
+	std::memcpy(m_Data.data() + offset, data.data(), data.size());
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::vector<uint8_t> MemoryByteSink::release() noexcept
+{
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	return std::move(m_Data);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryByteSink::MemoryByteSink(const uint64_t reserveSize)
+{
+	m_Data.reserve(reserveSize);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void FileDescriptorByteSink::write(std::span<const uint8_t> data, const uint64_t offset)
+{
+	writeToDescriptor(m_FileDescriptor, m_Mutex, data, offset);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+FileDescriptorByteSink::FileDescriptorByteSink(const int fileDescriptor, const bool takeOwnership)
+{
+	if (fileDescriptor < 0)
+	{
+		PSAPI_LOG_ERROR("FileDescriptorByteSink", "Invalid file descriptor %i passed", fileDescriptor);
+	}
+	m_FileDescriptor = fileDescriptor;
+	m_OwnsDescriptor = takeOwnership;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+FileDescriptorByteSink::~FileDescriptorByteSink()
+{
+	if (m_OwnsDescriptor && m_FileDescriptor >= 0)
+	{
+		closeDescriptor(m_FileDescriptor);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void CallbackByteSink::write(std::span<const uint8_t> data, const uint64_t offset)
+{
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	m_WriteFunction(data, offset);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void CallbackByteSink::flush()
+{
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	if (m_FlushFunction)
+	{
+		m_FlushFunction();
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+CallbackByteSink::CallbackByteSink(WriteFunction writeFunction, FlushFunction flushFunction)
+{
+	if (!writeFunction)
+	{
+		PSAPI_LOG_ERROR("CallbackByteSink", "A valid write function must be provided");
+	}
+	m_WriteFunction = std::move(writeFunction);
+	m_FlushFunction = std::move(flushFunction);
+}
+
+
+PSAPI_NAMESPACE_END
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "Macros.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#if (__cplusplus < 202002L)
+#include "tcb_span.hpp"
+#else
+#include <span>
+#endif
+
+
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+PSAPI_NAMESPACE_BEGIN
+
+
+/// Abstract random-access destination for bytes which a File writes to. Writes are always positional as the
+/// Photoshop format requires going back to fill out section sizes once they are known, writing past the current
+/// end extends the sink.
+///
+/// Implementations must be safe to call from multiple threads as long as the regions written do not overlap.
+struct ByteSink
+{
+	/// Write the given data to the offset in the sink
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual void write(std::span<const uint8_t> data, const uint64_t offset) = 0;
+
+	/// Push out any data held back by the sink itself, the default implementation is a no-op
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual void flush() {};
+
+	/// Hint that the output will be at least the given size in bytes, sinks may use this to preallocate
+	/// storage up front. The default implementation is a no-op
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual void reserve(const uint64_t size) {};
+
+	virtual ~ByteSink() = default;
+};
+
+
+/// Sink writing to a file on disk, this is what File uses when constructed from a path. The file is
+/// created (or truncated) on construction
+struct FileByteSink : public ByteSink
+{
+	void write(std::span<const uint8_t> data, const uint64_t offset) override;
+
+	FileByteSink(const std::filesystem::path& file);
+	~FileByteSink();
+
+private:
+	int m_FileDescriptor = -1;
+	std::mutex m_Mutex;		// Only used on platforms without positional writes
+};
+
+
+/// Sink writing to a memory mapped file on disk. Data is copied straight into place in the mapping rather than 
+/// going through a syscall per write. The file is preallocated to the reserved size (using fallocate where 
+/// available to avoid fragmentation) and otherwise grows geometrically as data is written past its end, 
+/// on flush it is truncated to the size actually written.
+struct MappedFileByteSink : public ByteSink
+{
+	void write(std::span<const uint8_t> data, const uint64_t offset) override;
+	void flush() override;
+	void reserve(const uint64_t size) override;
+
+	MappedFileByteSink(const std::filesystem::path& file);
+	~MappedFileByteSink();
+
+private:
+	std::filesystem::path m_FilePath;
+	mio::ummap_sink m_Mapping;
+	uint64_t m_Capacity = 0u;				// The current size of the file on disk and of the mapping
+	std::atomic<uint64_t> m_Size = 0u;		// The end of the data written so far
+	int m_FileDescriptor = -1;				// Kept open for the lifetime of the sink, used for preallocating where fallocate is available
+
+	// Writes to the mapping happen under a shared lock while resizing the file (which remaps it) is exclusive
+	std::shared_mutex m_Mutex;
+
+	/// Resize the file to the given capacity and remap it, the caller is expected to hold m_Mutex exclusively
+	void resize(const uint64_t capacity);
+};
+
+
+/// Sink writing to a file on disk while bypassing the page cache (O_DIRECT on Linux, F_NOCACHE on macOS). This keeps 
+/// large outputs which are never read back from evicting other data from the cache. Direct I/O requires the offset, 
+/// size and memory of every write to be aligned so data is copied through an aligned staging buffer and partially 
+/// covered blocks at either end of a write (e.g. the unaligned end of the file or a back-patched size marker) are 
+/// read, modified and written back. Writes are serialized as neighbouring writes may share such a block. On flush 
+/// the file is truncated to the size actually written.
+/// 
+/// If the file system does not support direct I/O we fall back to regular (cached) writes
+struct DirectFileByteSink : public ByteSink
+{
+	void write(std::span<const uint8_t> data, const uint64_t offset) override;
+	void flush() override;
+
+	/// Whether the file was successfully opened for direct I/O
+	bool isDirect() const noexcept { return m_IsDirect; };
+
+	/// \param file the file to write to, created or truncated on construction
+	/// \param alignment the alignment required by the device, must be a power of two
+	/// \param stagingSize the size of the aligned staging buffer, rounded up to a multiple of the alignment
+	DirectFileByteSink(const std::filesystem::path& file, const uint64_t alignment = 4096u, const uint64_t stagingSize = 1024u * 1024u * 8u);
+	~DirectFileByteSink();
+
+private:
+	int m_FileDescriptor = -1;
+	bool m_IsDirect = false;
+	uint64_t m_Alignment = 0u;
+	uint64_t m_StagingSize = 0u;
+	uint8_t* m_Staging = nullptr;	// Aligned to m_Alignment, owned by the sink
+	uint64_t m_Size = 0u;	// The end of the data written so far which the file is truncated to on flush
+	std::mutex m_Mutex;
+	std::mutex m_DescriptorMutex;	// Only used on platforms without positional writes
+
+	/// Fill the staging buffer at the given position with the current contents of the aligned block at 
+	/// offset, zero filling anything not yet written
+	void readBlock(uint8_t* buffer, const uint64_t offset);
+};
+
+
+/// Sink collecting all the data in a growing in-memory buffer
+struct MemoryByteSink : public ByteSink
+{
+	void write(std::span<const uint8_t> data, const uint64_t offset) override;
+
+	/// Get a view of the data written so far
+	std::span<const uint8_t> data() const noexcept { return m_Data; };
+
+	/// Move the data out of the sink, leaving it empty
+	std::vector<uint8_t> release() noexcept;
+
+	MemoryByteSink() = default;
+	/// Reserve the given amount of bytes up front to avoid reallocating as the buffer grows
+	MemoryByteSink(const uint64_t reserveSize);
+
+private:
+	std::vector<uint8_t> m_Data;
+	std::mutex m_Mutex;
+};
+
+
+/// Sink writing to an already opened file descriptor using positional writes, the file descriptor must
+/// refer to a seekable file. If takeOwnership is true the descriptor is closed on destruction
+struct FileDescriptorByteSink : public ByteSink
+{
+	void write(std::span<const uint8_t> data, const uint64_t offset) override;
+
+	FileDescriptorByteSink(const int fileDescriptor, const bool takeOwnership = false);
+	~FileDescriptorByteSink();
+
+private:
+	int m_FileDescriptor = -1;
+	bool m_OwnsDescriptor = false;
+	std::mutex m_Mutex;		// Only used on platforms without positional writes
+};
+
+
+/// Sink forwarding every write to a user provided function which receives the data and the offset it belongs to.
+/// Offsets are not guaranteed to be monotonic as size markers are filled in after the fact. Calls to the
+/// functions are serialized so they do not need to be thread-safe
+struct CallbackByteSink : public ByteSink
+{
+	using WriteFunction = std::function<void(std::span<const uint8_t> data, const uint64_t offset)>;
+	using FlushFunction = std::function<void()>;
+
+	void write(std::span<const uint8_t> data, const uint64_t offset) override;
+	void flush() override;
+
+	CallbackByteSink(WriteFunction writeFunction, FlushFunction flushFunction = nullptr);
+
+private:
+	WriteFunction m_WriteFunction;
+	FlushFunction m_FlushFunction;
+	std::mutex m_Mutex;
+};
+
+
+PSAPI_NAMESPACE_END
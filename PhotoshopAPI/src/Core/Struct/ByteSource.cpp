@@ -0,0 +1,1003 @@
+#include "ByteSource.h"
+
+#include "Profiling/Perf/Instrumentor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <execution>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#define PSAPI_POSITIONAL_IO 1
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+#if defined(PSAPI_USE_IO_URING) && defined(__linux__)
+#include <atomic>
+#include <deque>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+PSAPI_NAMESPACE_BEGIN
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::span<const uint8_t> ByteSource::view(const uint64_t offset, const uint64_t size) const
+{
+	PSAPI_LOG_ERROR("ByteSource", "The given byte source does not support creating views into its data");
+	return {};
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ByteSource::readBatch(std::span<const ReadRequest> requests)
+{
+	PROFILE_FUNCTION();
+#ifdef __APPLE__
+	std::for_each(requests.begin(), requests.end(), [&](const ReadRequest& request)
+#else
+	std::for_each(std::execution::par, requests.begin(), requests.end(), [&](const ReadRequest& request)
+#endif
+	{
+		read(request.buffer, request.offset, request.size);
+	});
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MappedFileByteSource::read(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	std::memcpy(buffer, m_Mapping.data() + offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::span<const uint8_t> MappedFileByteSource::view(const uint64_t offset, const uint64_t size) const
+{
+	return std::span<const uint8_t>(m_Mapping.data() + offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+bool MappedFileByteSource::advise(const uint64_t offset, const uint64_t size, const Advice advice)
+{
+#ifdef PSAPI_POSITIONAL_IO
+	if (size == 0u || !m_Mapping.is_mapped())
+	{
+		return false;
+	}
+	static const uint64_t pageSize = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+	// The mapping always starts at the beginning of the file so it is page aligned
+	const uint64_t base = reinterpret_cast<uint64_t>(m_Mapping.data());
+	uint64_t start = base + offset;
+	uint64_t end = base + offset + size;
+	if (advice == Advice::WillNeed)
+	{
+		// Prefetching a little more than requested is harmless
+		start = start & ~(pageSize - 1u);
+		return ::madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED) == 0;
+	}
+	// Only release pages lying entirely within the range as the edges may be shared with data still in use
+	start = (start + pageSize - 1u) & ~(pageSize - 1u);
+	end = end & ~(pageSize - 1u);
+	if (end <= start)
+	{
+		return false;
+	}
+	return ::madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED) == 0;
+#else
+	return false;
+#endif
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MappedFileByteSource::MappedFileByteSource(const std::filesystem::path& file)
+{
+	m_Size = static_cast<uint64_t>(std::filesystem::file_size(file));
+	// Mapping an empty file is an error so we only map if there is anything to map
+	if (m_Size > 0)
+	{
+		m_Mapping = mio::ummap_source(file.string());
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MemoryByteSource::read(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	std::memcpy(buffer, m_View.data() + offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::span<const uint8_t> MemoryByteSource::view(const uint64_t offset, const uint64_t size) const
+{
+	return m_View.subspan(offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryByteSource::MemoryByteSource(std::vector<uint8_t>&& data)
+{
+	m_Data = std::move(data);
+	m_View = std::span<const uint8_t>(m_Data.data(), m_Data.size());
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryByteSource::MemoryByteSource(std::span<const uint8_t> data)
+{
+	m_View = data;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void FileDescriptorByteSource::read(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	PROFILE_FUNCTION();
+	uint64_t bytesRead = 0u;
+#ifdef PSAPI_POSITIONAL_IO
+	while (bytesRead < size)
+	{
+		ssize_t result = ::pread(m_FileDescriptor, buffer + bytesRead, size - bytesRead, static_cast<off_t>(offset + bytesRead));
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			PSAPI_LOG_ERROR("FileDescriptorByteSource", "Failed to read %" PRIu64 " bytes from offset %" PRIu64 "", size, offset);
+		}
+		bytesRead += static_cast<uint64_t>(result);
+	}
+#elif defined(_WIN32)
+	// Windows has no positional reads on file descriptors so we serialize the seek and read
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	_lseeki64(m_FileDescriptor, static_cast<__int64>(offset), SEEK_SET);
+	while (bytesRead < size)
+	{
+		const unsigned int toRead = static_cast<unsigned int>(std::min<uint64_t>(size - bytesRead, (std::numeric_limits<int>::max)()));
+		int result = _read(m_FileDescriptor, buffer + bytesRead, toRead);
+		if (result <= 0)
+		{
+			PSAPI_LOG_ERROR("FileDescriptorByteSource", "Failed to read %" PRIu64 " bytes from offset %" PRIu64 "", size, offset);
+		}
+		bytesRead += static_cast<uint64_t>(result);
+	}
+#endif
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+FileDescriptorByteSource::FileDescriptorByteSource(const int fileDescriptor, const bool takeOwnership)
+{
+	m_FileDescriptor = fileDescriptor;
+	m_OwnsDescriptor = takeOwnership;
+#ifdef PSAPI_POSITIONAL_IO
+	struct stat fileStat;
+	if (::fstat(m_FileDescriptor, &fileStat) != 0)
+	{
+		PSAPI_LOG_ERROR("FileDescriptorByteSource", "Unable to query the size of file descriptor %i", fileDescriptor);
+	}
+	m_Size = static_cast<uint64_t>(fileStat.st_size);
+#elif defined(_WIN32)
+	__int64 size = _filelengthi64(m_FileDescriptor);
+	if (size < 0)
+	{
+		PSAPI_LOG_ERROR("FileDescriptorByteSource", "Unable to query the size of file descriptor %i", fileDescriptor);
+	}
+	m_Size = static_cast<uint64_t>(size);
+#endif
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+FileDescriptorByteSource::~FileDescriptorByteSource()
+{
+	if (m_OwnsDescriptor && m_FileDescriptor >= 0)
+	{
+#ifdef PSAPI_POSITIONAL_IO
+		::close(m_FileDescriptor);
+#elif defined(_WIN32)
+		_close(m_FileDescriptor);
+#endif
+	}
+}
+
+
+#if defined(PSAPI_USE_IO_URING) && defined(__linux__)
+
+
+namespace
+{
+	// A single read operation submitted to the ring, requests larger than what a single operation 
+	// can read as well as short reads get split into multiple of these
+	struct IoUringOperation
+	{
+		char* buffer = nullptr;
+		uint64_t offset = 0u;
+		uint64_t size = 0u;
+	};
+
+	// The largest amount of bytes we read with a single operation, the kernel caps reads at just below 2GB
+	constexpr uint64_t s_MaxOperationSize = 1024u * 1024u * 1024u;
+
+	// Check whether the kernel supports the given operation on the ring. Kernels predating the probe (before 5.6)
+	// do not support IORING_OP_READ either so a failing probe is treated as the operation being unsupported
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	bool probeOperation(const int ringFd, const uint8_t opcode)
+	{
+		constexpr uint32_t numOperations = 256u;
+		std::vector<uint8_t> buffer(sizeof(io_uring_probe) + numOperations * sizeof(io_uring_probe_op), 0u);
+		auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+		if (::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, numOperations) < 0)
+		{
+			return false;
+		}
+		return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+	}
+
+
+	// Positional read which retries on interrupts and short reads
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	void preadAll(const int fileDescriptor, char* buffer, const uint64_t offset, const uint64_t size)
+	{
+		uint64_t bytesRead = 0u;
+		while (bytesRead < size)
+		{
+			ssize_t result = ::pread(fileDescriptor, buffer + bytesRead, size - bytesRead, static_cast<off_t>(offset + bytesRead));
+			if (result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (result <= 0)
+			{
+				PSAPI_LOG_ERROR("IoUringByteSource", "Failed to read %" PRIu64 " bytes from offset %" PRIu64 "", size, offset);
+			}
+			bytesRead += static_cast<uint64_t>(result);
+		}
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void IoUringByteSource::read(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	PROFILE_FUNCTION();
+	preadAll(m_FileDescriptor, buffer, offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void IoUringByteSource::readBatch(std::span<const ReadRequest> requests)
+{
+	PROFILE_FUNCTION();
+	if (!hasRing())
+	{
+		ByteSource::readBatch(requests);
+		return;
+	}
+
+	std::deque<IoUringOperation> pending;
+	for (const auto& request : requests)
+	{
+		for (uint64_t done = 0u; done < request.size; done += s_MaxOperationSize)
+		{
+			pending.push_back({ request.buffer + done, request.offset + done, std::min(s_MaxOperationSize, request.size - done) });
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	std::vector<IoUringOperation> inFlight(m_QueueDepth);
+	std::vector<uint32_t> freeSlots;
+	for (uint32_t i = 0; i < m_QueueDepth; ++i)
+	{
+		freeSlots.push_back(m_QueueDepth - 1u - i);
+	}
+	auto* sqes = reinterpret_cast<io_uring_sqe*>(m_SubmissionEntries);
+	auto* cqes = reinterpret_cast<io_uring_cqe*>(m_Cqes);
+
+	// The reads in flight write into the callers' buffers so on failure we may only raise an error once all of them
+	// have completed. Until then we stop submitting and only keep on reaping, which also leaves no stale completions 
+	// in the ring for the next batch
+	int submitError = 0;
+	int readError = 0;
+	IoUringOperation failedOperation{};
+
+	while (!pending.empty() || freeSlots.size() < m_QueueDepth)
+	{
+		// Fill up the submission queue, we are the only producer so only the kernel side needs synchronizing
+		uint32_t toSubmit = 0u;
+		uint32_t tail = std::atomic_ref<uint32_t>(*m_SqTail).load(std::memory_order_relaxed);
+		while (!pending.empty() && !freeSlots.empty())
+		{
+			const uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			inFlight[slot] = pending.front();
+			pending.pop_front();
+
+			const uint32_t index = tail & *m_SqMask;
+			io_uring_sqe& sqe = sqes[index];
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = IORING_OP_READ;
+			sqe.fd = m_FileDescriptor;
+			sqe.addr = reinterpret_cast<uint64_t>(inFlight[slot].buffer);
+			sqe.len = static_cast<uint32_t>(inFlight[slot].size);
+			sqe.off = inFlight[slot].offset;
+			sqe.user_data = slot;
+			m_SqArray[index] = index;
+			++tail;
+			++toSubmit;
+		}
+		std::atomic_ref<uint32_t>(*m_SqTail).store(tail, std::memory_order_release);
+		// Entries left over from an interrupted submission are still in the queue so we submit everything the
+		// kernel has not consumed yet rather than just what we added
+		toSubmit = tail - std::atomic_ref<uint32_t>(*m_SqHead).load(std::memory_order_acquire);
+
+		int result = static_cast<int>(::syscall(__NR_io_uring_enter, m_RingFd, toSubmit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0));
+		if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY && submitError == 0 && readError == 0)
+		{
+			submitError = errno;
+			// Take back whatever the kernel has not consumed, these were never started and are therefore safe to drop
+			const uint32_t sqHead = std::atomic_ref<uint32_t>(*m_SqHead).load(std::memory_order_acquire);
+			for (uint32_t i = sqHead; i != tail; ++i)
+			{
+				freeSlots.push_back(static_cast<uint32_t>(sqes[m_SqArray[i & *m_SqMask]].user_data));
+			}
+			std::atomic_ref<uint32_t>(*m_SqTail).store(sqHead, std::memory_order_release);
+			pending.clear();
+		}
+
+		// Reap everything that has completed so far
+		uint32_t head = std::atomic_ref<uint32_t>(*m_CqHead).load(std::memory_order_relaxed);
+		while (head != std::atomic_ref<uint32_t>(*m_CqTail).load(std::memory_order_acquire))
+		{
+			const io_uring_cqe& cqe = cqes[head & *m_CqMask];
+			const uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+			IoUringOperation operation = inFlight[slot];
+			freeSlots.push_back(slot);
+
+			if (submitError != 0 || readError != 0)
+			{
+				// We are only waiting for the remaining reads to finish
+			}
+			else if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+			{
+				pending.push_back(operation);
+			}
+			else if (cqe.res <= 0)
+			{
+				readError = cqe.res == 0 ? EIO : -cqe.res;
+				failedOperation = operation;
+				pending.clear();
+			}
+			else if (static_cast<uint64_t>(cqe.res) < operation.size)
+			{
+				// Short reads are legal so we just queue up the remainder
+				const uint64_t bytesRead = static_cast<uint64_t>(cqe.res);
+				pending.push_back({ operation.buffer + bytesRead, operation.offset + bytesRead, operation.size - bytesRead });
+			}
+			++head;
+		}
+		std::atomic_ref<uint32_t>(*m_CqHead).store(head, std::memory_order_release);
+	}
+
+	if (submitError != 0)
+	{
+		PSAPI_LOG_ERROR("IoUringByteSource", "Failed to submit reads to the ring, errno %i", submitError);
+	}
+	if (readError != 0)
+	{
+		PSAPI_LOG_ERROR("IoUringByteSource", "Failed to read %" PRIu64 " bytes from offset %" PRIu64 ", error %i", failedOperation.size, failedOperation.offset, readError);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+IoUringByteSource::IoUringByteSource(const std::filesystem::path& file, const uint32_t queueDepth)
+{
+	m_FileDescriptor = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (m_FileDescriptor < 0)
+	{
+		PSAPI_LOG_ERROR("IoUringByteSource", "Failed to open file: %s", file.string().c_str());
+	}
+	m_Size = static_cast<uint64_t>(std::filesystem::file_size(file));
+	setupRing(std::max(queueDepth, 1u));
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+IoUringByteSource::~IoUringByteSource()
+{
+	teardownRing();
+	if (m_FileDescriptor >= 0)
+	{
+		::close(m_FileDescriptor);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void IoUringByteSource::setupRing(const uint32_t queueDepth)
+{
+	io_uring_params params{};
+	m_RingFd = static_cast<int>(::syscall(__NR_io_uring_setup, queueDepth, &params));
+	if (m_RingFd < 0)
+	{
+		PSAPI_LOG_WARNING("IoUringByteSource", "Unable to set up io_uring (errno %i), falling back to positional reads", errno);
+		return;
+	}
+	// Reads require kernel 5.6, on older kernels the ring sets up fine but every read would fail
+	if (!probeOperation(m_RingFd, IORING_OP_READ))
+	{
+		teardownRing();
+		PSAPI_LOG_WARNING("IoUringByteSource", "The kernel does not support reads through io_uring, falling back to positional reads");
+		return;
+	}
+	// The kernel may round up the amount of entries but never gives us fewer
+	m_QueueDepth = std::min(queueDepth, params.sq_entries);
+
+	m_SubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	m_CompletionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	const bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMapping)
+	{
+		m_SubmissionRingSize = std::max(m_SubmissionRingSize, m_CompletionRingSize);
+	}
+
+	m_SubmissionRing = ::mmap(nullptr, m_SubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_SQ_RING);
+	if (m_SubmissionRing == MAP_FAILED)
+	{
+		m_SubmissionRing = nullptr;
+		teardownRing();
+		PSAPI_LOG_WARNING("IoUringByteSource", "Unable to map the io_uring submission ring, falling back to positional reads");
+		return;
+	}
+	if (singleMapping)
+	{
+		m_CompletionRing = m_SubmissionRing;
+	}
+	else
+	{
+		m_CompletionRing = ::mmap(nullptr, m_CompletionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_CQ_RING);
+		if (m_CompletionRing == MAP_FAILED)
+		{
+			m_CompletionRing = nullptr;
+			teardownRing();
+			PSAPI_LOG_WARNING("IoUringByteSource", "Unable to map the io_uring completion ring, falling back to positional reads");
+			return;
+		}
+	}
+	m_SubmissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+	m_SubmissionEntries = ::mmap(nullptr, m_SubmissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_RingFd, IORING_OFF_SQES);
+	if (m_SubmissionEntries == MAP_FAILED)
+	{
+		m_SubmissionEntries = nullptr;
+		teardownRing();
+		PSAPI_LOG_WARNING("IoUringByteSource", "Unable to map the io_uring submission entries, falling back to positional reads");
+		return;
+	}
+
+	auto* sqRing = reinterpret_cast<uint8_t*>(m_SubmissionRing);
+	auto* cqRing = reinterpret_cast<uint8_t*>(m_CompletionRing);
+	m_SqHead = reinterpret_cast<uint32_t*>(sqRing + params.sq_off.head);
+	m_SqTail = reinterpret_cast<uint32_t*>(sqRing + params.sq_off.tail);
+	m_SqMask = reinterpret_cast<uint32_t*>(sqRing + params.sq_off.ring_mask);
+	m_SqArray = reinterpret_cast<uint32_t*>(sqRing + params.sq_off.array);
+	m_CqHead = reinterpret_cast<uint32_t*>(cqRing + params.cq_off.head);
+	m_CqTail = reinterpret_cast<uint32_t*>(cqRing + params.cq_off.tail);
+	m_CqMask = reinterpret_cast<uint32_t*>(cqRing + params.cq_off.ring_mask);
+	m_Cqes = cqRing + params.cq_off.cqes;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void IoUringByteSource::teardownRing() noexcept
+{
+	if (m_SubmissionEntries)
+	{
+		::munmap(m_SubmissionEntries, m_SubmissionEntriesSize);
+	}
+	if (m_CompletionRing && m_CompletionRing != m_SubmissionRing)
+	{
+		::munmap(m_CompletionRing, m_CompletionRingSize);
+	}
+	if (m_SubmissionRing)
+	{
+		::munmap(m_SubmissionRing, m_SubmissionRingSize);
+	}
+	m_SubmissionEntries = nullptr;
+	m_CompletionRing = nullptr;
+	m_SubmissionRing = nullptr;
+	if (m_RingFd >= 0)
+	{
+		::close(m_RingFd);
+		m_RingFd = -1;
+	}
+}
+
+
+#endif
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void RangeRequestByteSource::read(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	PROFILE_FUNCTION();
+	if (size == 0u)
+	{
+		return;
+	}
+	// Large reads would only evict the metadata from the cache
+	if (size >= m_Params.blockSize)
+	{
+		fetch(buffer, offset, size);
+		return;
+	}
+
+	const uint64_t firstBlock = offset / m_Params.blockSize;
+	const uint64_t lastBlock = (offset + size - 1u) / m_Params.blockSize;
+
+	// Copy the part of the requested range covered by the given block into the buffer
+	auto copyBlock = [&](const uint64_t block, const std::vector<uint8_t>& data)
+		{
+			const uint64_t blockOffset = block * m_Params.blockSize;
+			const uint64_t copyStart = std::max(offset, blockOffset);
+			const uint64_t copyEnd = std::min(offset + size, blockOffset + data.size());
+			std::memcpy(buffer + (copyStart - offset), data.data() + (copyStart - blockOffset), copyEnd - copyStart);
+		};
+
+	// Copy out the cached blocks and collect the runs of consecutive missing blocks which we then fetch with a single
+	// request each. The missing blocks are marked as in flight so other readers wait for them rather than fetching
+	// them as well
+	std::vector<std::pair<uint64_t, uint64_t>> missingRuns;
+	uint64_t hits = 0u;
+	{
+		std::unique_lock<std::mutex> lock(m_CacheMutex);
+		m_FetchCondition.wait(lock, [&]()
+			{
+				for (uint64_t block = firstBlock; block <= lastBlock; ++block)
+				{
+					if (m_InFlightBlocks.contains(block))
+					{
+						return false;
+					}
+				}
+				return true;
+			});
+		for (uint64_t block = firstBlock; block <= lastBlock; ++block)
+		{
+			if (auto it = m_BlockLookup.find(block); it != m_BlockLookup.end())
+			{
+				// Mark the block as recently used so it is not evicted by the blocks we are about to fetch
+				m_Blocks.splice(m_Blocks.begin(), m_Blocks, it->second);
+				copyBlock(block, it->second->second);
+				++hits;
+				continue;
+			}
+			if (!missingRuns.empty() && missingRuns.back().second + 1u == block)
+			{
+				missingRuns.back().second = block;
+			}
+			else
+			{
+				missingRuns.emplace_back(block, block);
+			}
+			m_InFlightBlocks.insert(block);
+		}
+	}
+
+	// Fetch without holding the lock so readers of other blocks are not stalled by the request
+	std::vector<std::pair<uint64_t, std::vector<uint8_t>>> fetchedBlocks;
+	try
+	{
+		for (const auto& [runStart, runEnd] : missingRuns)
+		{
+			const uint64_t runOffset = runStart * m_Params.blockSize;
+			const uint64_t runSize = std::min((runEnd + 1u) * m_Params.blockSize, m_Size) - runOffset;
+			std::vector<uint8_t> data(runSize);
+			fetch(reinterpret_cast<char*>(data.data()), runOffset, runSize);
+			for (uint64_t block = runStart; block <= runEnd; ++block)
+			{
+				const uint64_t blockStart = (block - runStart) * m_Params.blockSize;
+				const uint64_t blockEnd = std::min(blockStart + m_Params.blockSize, runSize);
+				fetchedBlocks.emplace_back(block, std::vector<uint8_t>(data.begin() + blockStart, data.begin() + blockEnd));
+				copyBlock(block, fetchedBlocks.back().second);
+			}
+		}
+	}
+	catch (...)
+	{
+		// Release the blocks so waiting readers retry the fetch themselves
+		{
+			std::lock_guard<std::mutex> guard(m_CacheMutex);
+			for (const auto& [runStart, runEnd] : missingRuns)
+			{
+				for (uint64_t block = runStart; block <= runEnd; ++block)
+				{
+					m_InFlightBlocks.erase(block);
+				}
+			}
+		}
+		m_FetchCondition.notify_all();
+		throw;
+	}
+
+	if (!fetchedBlocks.empty())
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_CacheMutex);
+			for (auto& [block, data] : fetchedBlocks)
+			{
+				insertBlock(block, std::move(data));
+				m_InFlightBlocks.erase(block);
+			}
+		}
+		m_FetchCondition.notify_all();
+	}
+
+	std::lock_guard<std::mutex> statsGuard(m_StatsMutex);
+	m_Stats.cacheHits += hits;
+	m_Stats.cacheMisses += fetchedBlocks.size();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void RangeRequestByteSource::readBatch(std::span<const ReadRequest> requests)
+{
+	PROFILE_FUNCTION();
+	// A group of requests which is fetched with a single ranged request
+	struct CoalescedRequest
+	{
+		uint64_t offset = 0u;
+		uint64_t size = 0u;
+		std::vector<ReadRequest> requests;
+	};
+
+	std::vector<ReadRequest> sorted(requests.begin(), requests.end());
+	std::sort(sorted.begin(), sorted.end(), [](const ReadRequest& a, const ReadRequest& b) { return a.offset < b.offset; });
+	std::vector<CoalescedRequest> coalesced;
+	for (const auto& request : sorted)
+	{
+		if (request.size == 0u)
+		{
+			continue;
+		}
+		if (!coalesced.empty())
+		{
+			CoalescedRequest& previous = coalesced.back();
+			const uint64_t previousEnd = previous.offset + previous.size;
+			const uint64_t mergedEnd = std::max(previousEnd, request.offset + request.size);
+			if (request.offset <= previousEnd + m_Params.coalesceGap && mergedEnd - previous.offset <= m_Params.maxRequestSize)
+			{
+				previous.size = mergedEnd - previous.offset;
+				previous.requests.push_back(request);
+				continue;
+			}
+		}
+		coalesced.push_back({ request.offset, request.size, { request } });
+	}
+
+#ifdef __APPLE__
+	std::for_each(coalesced.begin(), coalesced.end(), [&](const CoalescedRequest& group)
+#else
+	std::for_each(std::execution::par, coalesced.begin(), coalesced.end(), [&](const CoalescedRequest& group)
+#endif
+	{
+		// A lone request can be fetched straight into its buffer
+		if (group.requests.size() == 1u)
+		{
+			fetch(group.requests[0].buffer, group.offset, group.size);
+			return;
+		}
+		std::vector<uint8_t> data(group.size);
+		fetch(reinterpret_cast<char*>(data.data()), group.offset, group.size);
+		for (const auto& request : group.requests)
+		{
+			std::memcpy(request.buffer, data.data() + (request.offset - group.offset), request.size);
+		}
+	});
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+RangeRequestByteSource::Stats RangeRequestByteSource::getStats() const
+{
+	std::lock_guard<std::mutex> guard(m_StatsMutex);
+	return m_Stats;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void RangeRequestByteSource::fetch(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	PROFILE_FUNCTION();
+	m_FetchFunction(buffer, offset, size);
+	std::lock_guard<std::mutex> guard(m_StatsMutex);
+	m_Stats.requests += 1u;
+	m_Stats.bytesFetched += size;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void RangeRequestByteSource::insertBlock(const uint64_t index, std::vector<uint8_t>&& data)
+{
+	if (m_Blocks.size() >= m_Params.cacheBlocks)
+	{
+		m_BlockLookup.erase(m_Blocks.back().first);
+		m_Blocks.pop_back();
+	}
+	m_Blocks.emplace_front(index, std::move(data));
+	m_BlockLookup[index] = m_Blocks.begin();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+RangeRequestByteSource::RangeRequestByteSource(FetchFunction fetchFunction, const uint64_t size, const Params params)
+{
+	if (!fetchFunction)
+	{
+		PSAPI_LOG_ERROR("RangeRequestByteSource", "A valid fetch function must be provided");
+	}
+	if (params.blockSize == 0u)
+	{
+		PSAPI_LOG_ERROR("RangeRequestByteSource", "The block size must be larger than 0");
+	}
+	m_FetchFunction = std::move(fetchFunction);
+	m_Size = size;
+	m_Params = params;
+	// A read smaller than a block may straddle two blocks which must both fit into the cache at once
+	m_Params.cacheBlocks = std::max<uint64_t>(m_Params.cacheBlocks, 2u);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void StreamByteSource::read(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	PROFILE_FUNCTION();
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	if (offset < m_BufferOffset)
+	{
+		PSAPI_LOG_ERROR("StreamByteSource", "Cannot read from offset %" PRIu64 " of a non-seekable stream as everything up to offset %" PRIu64 " was already released",
+			offset, m_BufferOffset);
+	}
+	const uint64_t streamOffset = m_BufferOffset + m_Buffer.size();
+	if (offset > streamOffset)
+	{
+		// Nothing we buffered is needed anymore and the data up to the offset is skipped so we never hold on to it
+		m_Buffer.clear();
+		m_BufferOffset = streamOffset;
+		drop(offset - streamOffset);
+	}
+
+	// Large reads such as the channel image data of a layer are read straight into the callers' buffer rather than
+	// through our own, only the end of it is retained for small backwards jumps
+	const uint64_t bufferedSize = std::min(size, m_BufferOffset + m_Buffer.size() - offset);
+	if (size - bufferedSize > m_RetainSize)
+	{
+		std::memcpy(buffer, m_Buffer.data() + (offset - m_BufferOffset), bufferedSize);
+		readInto(buffer + bufferedSize, size - bufferedSize);
+		const uint64_t retained = std::min(size, m_RetainSize);
+		m_Buffer = decltype(m_Buffer)(buffer + size - retained, buffer + size);
+		m_BufferOffset = offset + size - retained;
+		m_HighWaterMark = std::max<uint64_t>(m_HighWaterMark, m_Buffer.size());
+		return;
+	}
+	fill(offset + size);
+	std::memcpy(buffer, m_Buffer.data() + (offset - m_BufferOffset), size);
+	release(offset - std::min(offset, m_RetainSize));
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void StreamByteSource::readBatch(std::span<const ReadRequest> requests)
+{
+	PROFILE_FUNCTION();
+	std::vector<ReadRequest> sorted(requests.begin(), requests.end());
+	std::sort(sorted.begin(), sorted.end(), [](const ReadRequest& a, const ReadRequest& b) { return a.offset < b.offset; });
+	for (const auto& request : sorted)
+	{
+		read(request.buffer, request.offset, request.size);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+uint64_t StreamByteSource::getBufferHighWaterMark() const
+{
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	return m_HighWaterMark;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void StreamByteSource::fill(const uint64_t end)
+{
+	while (m_BufferOffset + m_Buffer.size() < end)
+	{
+		const uint64_t previousSize = m_Buffer.size();
+		const uint64_t toRead = end - (m_BufferOffset + previousSize);
+		m_Buffer.resize(previousSize + toRead);
+		const uint64_t bytesRead = m_ReadFunction(reinterpret_cast<char*>(m_Buffer.data() + previousSize), toRead);
+		m_Buffer.resize(previousSize + bytesRead);
+		if (bytesRead == 0u)
+		{
+			PSAPI_LOG_ERROR("StreamByteSource", "Unexpected end of stream at offset %" PRIu64 " while reading up to offset %" PRIu64 "",
+				m_BufferOffset + m_Buffer.size(), end);
+		}
+	}
+	m_HighWaterMark = std::max<uint64_t>(m_HighWaterMark, m_Buffer.size());
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void StreamByteSource::readInto(char* buffer, uint64_t size)
+{
+	while (size > 0u)
+	{
+		const uint64_t bytesRead = m_ReadFunction(buffer, size);
+		if (bytesRead == 0u)
+		{
+			PSAPI_LOG_ERROR("StreamByteSource", "Unexpected end of stream at offset %" PRIu64 " while reading %" PRIu64 " more bytes",
+				m_BufferOffset + m_Buffer.size(), size);
+		}
+		buffer += bytesRead;
+		size -= bytesRead;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void StreamByteSource::drop(uint64_t size)
+{
+	std::vector<char> scratch(std::min<uint64_t>(size, 1024u * 64u));
+	while (size > 0u)
+	{
+		const uint64_t bytesRead = m_ReadFunction(scratch.data(), std::min<uint64_t>(size, scratch.size()));
+		if (bytesRead == 0u)
+		{
+			PSAPI_LOG_ERROR("StreamByteSource", "Unexpected end of stream at offset %" PRIu64 " while skipping data", m_BufferOffset);
+		}
+		size -= bytesRead;
+		m_BufferOffset += bytesRead;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void StreamByteSource::release(const uint64_t offset)
+{
+	if (offset <= m_BufferOffset)
+	{
+		return;
+	}
+	const uint64_t toRelease = std::min<uint64_t>(offset - m_BufferOffset, m_Buffer.size());
+	// Erasing from the front moves the remaining data so we only do so once it amounts to a significant part of the buffer
+	// or of the retained window, the latter keeps many small consecutive reads (e.g. small layers) from piling up
+	if (toRelease >= std::min<uint64_t>(m_Buffer.size(), m_RetainSize) / 2u)
+	{
+		m_Buffer.erase(m_Buffer.begin(), m_Buffer.begin() + toRelease);
+		m_BufferOffset += toRelease;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+StreamByteSource::StreamByteSource(ReadFunction readFunction, const uint64_t size, const uint64_t retainSize)
+{
+	if (!readFunction)
+	{
+		PSAPI_LOG_ERROR("StreamByteSource", "A valid read function must be provided");
+	}
+	m_ReadFunction = std::move(readFunction);
+	m_Size = size;
+	m_RetainSize = retainSize;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+StreamByteSource::StreamByteSource(const int fileDescriptor, const uint64_t size, const uint64_t retainSize)
+	: StreamByteSource([fileDescriptor](char* buffer, const uint64_t size) -> uint64_t
+		{
+			while (true)
+			{
+#ifdef PSAPI_POSITIONAL_IO
+				ssize_t result = ::read(fileDescriptor, buffer, size);
+				if (result < 0 && errno == EINTR)
+				{
+					continue;
+				}
+#elif defined(_WIN32)
+				int result = _read(fileDescriptor, buffer, static_cast<unsigned int>(std::min<uint64_t>(size, (std::numeric_limits<int>::max)())));
+#endif
+				if (result < 0)
+				{
+					PSAPI_LOG_ERROR("StreamByteSource", "Failed to read from file descriptor %i", fileDescriptor);
+				}
+				return static_cast<uint64_t>(result);
+			}
+		}, size, retainSize)
+{
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+StreamByteSource::StreamByteSource(std::istream& stream, const uint64_t size, const uint64_t retainSize)
+	: StreamByteSource([&stream](char* buffer, const uint64_t size) -> uint64_t
+		{
+			stream.read(buffer, static_cast<std::streamsize>(size));
+			return static_cast<uint64_t>(stream.gcount());
+		}, size, retainSize)
+{
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void CallbackByteSource::read(char* buffer, const uint64_t offset, const uint64_t size)
+{
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	m_ReadFunction(buffer, offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+CallbackByteSource::CallbackByteSource(ReadFunction readFunction, const uint64_t size)
+{
+	if (!readFunction)
+	{
+		PSAPI_LOG_ERROR("CallbackByteSource", "A valid read function must be provided");
+	}
+	m_ReadFunction = std::move(readFunction);
+	m_Size = size;
+}
+
+
+PSAPI_NAMESPACE_END
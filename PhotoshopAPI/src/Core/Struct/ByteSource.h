@@ -0,0 +1,354 @@
+#pragma once
+
+#include "Macros.h"
+#include "Logger.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#if (__cplusplus < 202002L)
+#include "tcb_span.hpp"
+#else
+#include <span>
+#endif
+
+
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+PSAPI_NAMESPACE_BEGIN
+
+
+/// Abstract random-access source of bytes which a File reads from. Bounds checking is done by the File itself
+/// so implementations may assume every requested range lies within [0, size()).
+///
+/// Implementations must be safe to call from multiple threads as channel data is read in parallel.
+struct ByteSource
+{
+	/// A single read of size bytes at offset into buffer as part of a batch
+	struct ReadRequest
+	{
+		char* buffer = nullptr;
+		uint64_t offset = 0u;
+		uint64_t size = 0u;
+	};
+
+	/// Read size bytes starting at offset into the given buffer, the buffer must be properly allocated
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual void read(char* buffer, const uint64_t offset, const uint64_t size) = 0;
+
+	/// Read all of the given requests, returning once every one of them has completed. The default 
+	/// implementation issues the reads in parallel through read()
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual void readBatch(std::span<const ReadRequest> requests);
+
+	/// Hints about how a range of the source will be accessed next, see advise()
+	enum class Advice
+	{
+		WillNeed,	// The range is about to be read and should be brought into memory ahead of time
+		DontNeed	// The range has been consumed and its memory may be released
+	};
+
+	/// Hint how the given range of the source will be accessed next. Returns whether the hint was applied, the 
+	/// default implementation ignores all hints
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual bool advise(const uint64_t offset, const uint64_t size, const Advice advice) { return false; };
+
+	/// Whether the source benefits from being handed many reads at once via readBatch() rather than
+	/// individual reads, e.g. because it can keep many requests in flight on high-latency storage
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual bool prefersBatchedReads() const noexcept { return false; };
+
+	/// Whether reads may be issued at arbitrary offsets in any order and at any later point in time, this is 
+	/// not the case for streams which can only be consumed front to back
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual bool isSeekable() const noexcept { return true; };
+
+	/// Return the total size of the source in bytes
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual uint64_t size() const noexcept = 0;
+
+	/// Whether the source is contiguous in memory and can therefore hand out views via view()
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual bool supportsView() const noexcept { return false; };
+
+	/// Return a read-only view into the source without copying, only valid if supportsView() is true.
+	/// The view is valid for the lifetime of the source
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	virtual std::span<const uint8_t> view(const uint64_t offset, const uint64_t size) const;
+
+	virtual ~ByteSource() = default;
+};
+
+
+/// Source backed by a memory mapped file on disk, this is what File uses when constructed from a path
+struct MappedFileByteSource : public ByteSource
+{
+	void read(char* buffer, const uint64_t offset, const uint64_t size) override;
+	uint64_t size() const noexcept override { return m_Size; };
+	bool supportsView() const noexcept override { return true; };
+	std::span<const uint8_t> view(const uint64_t offset, const uint64_t size) const override;
+	/// Forward the hint to the kernel using madvise, WillNeed starts reading the pages in the background 
+	/// while DontNeed drops them from our address space (they are faulted back in if accessed again)
+	bool advise(const uint64_t offset, const uint64_t size, const Advice advice) override;
+
+	MappedFileByteSource(const std::filesystem::path& file);
+
+private:
+	mio::ummap_source m_Mapping;
+	uint64_t m_Size = 0u;
+};
+
+
+/// Source over a buffer in memory, either owning the data or referencing memory owned by the caller in
+/// which case the memory must outlive the source (and any File constructed from it)
+struct MemoryByteSource : public ByteSource
+{
+	void read(char* buffer, const uint64_t offset, const uint64_t size) override;
+	uint64_t size() const noexcept override { return m_View.size(); };
+	bool supportsView() const noexcept override { return true; };
+	std::span<const uint8_t> view(const uint64_t offset, const uint64_t size) const override;
+
+	/// Take ownership of the given data
+	MemoryByteSource(std::vector<uint8_t>&& data);
+	/// Reference data owned by the caller without copying
+	MemoryByteSource(std::span<const uint8_t> data);
+
+private:
+	std::vector<uint8_t> m_Data;
+	std::span<const uint8_t> m_View;
+};
+
+
+/// Source reading from an already opened file descriptor using positional reads, the file descriptor must
+/// refer to a seekable file. If takeOwnership is true the descriptor is closed on destruction
+struct FileDescriptorByteSource : public ByteSource
+{
+	void read(char* buffer, const uint64_t offset, const uint64_t size) override;
+	uint64_t size() const noexcept override { return m_Size; };
+
+	FileDescriptorByteSource(const int fileDescriptor, const bool takeOwnership = false);
+	~FileDescriptorByteSource();
+
+private:
+	int m_FileDescriptor = -1;
+	bool m_OwnsDescriptor = false;
+	uint64_t m_Size = 0u;
+	std::mutex m_Mutex;		// Only used on platforms without positional reads
+};
+
+
+#if defined(PSAPI_USE_IO_URING) && defined(__linux__)
+/// Source reading a file on disk through io_uring. Individual reads are plain positional reads while batches are 
+/// submitted to the kernel all at once with up to queueDepth requests in flight, which on high-latency storage 
+/// such as network or cloud block devices is much faster than faulting in a memory mapping page by page.
+/// If io_uring is unavailable at runtime (e.g. disabled by the kernel) batches fall back to positional reads.
+/// 
+/// Only available on Linux when compiled with PSAPI_USE_IO_URING
+struct IoUringByteSource : public ByteSource
+{
+	void read(char* buffer, const uint64_t offset, const uint64_t size) override;
+	void readBatch(std::span<const ReadRequest> requests) override;
+	uint64_t size() const noexcept override { return m_Size; };
+	bool prefersBatchedReads() const noexcept override { return true; };
+
+	/// Whether the ring was set up successfully, if not batches are read using positional reads
+	bool hasRing() const noexcept { return m_RingFd >= 0; };
+
+	IoUringByteSource(const std::filesystem::path& file, const uint32_t queueDepth = 64u);
+	~IoUringByteSource();
+
+private:
+	int m_FileDescriptor = -1;
+	uint64_t m_Size = 0u;
+
+	int m_RingFd = -1;
+	uint32_t m_QueueDepth = 0u;
+	// The mappings shared with the kernel, the submission and completion rings may share a mapping
+	void* m_SubmissionRing = nullptr;
+	size_t m_SubmissionRingSize = 0u;
+	void* m_CompletionRing = nullptr;
+	size_t m_CompletionRingSize = 0u;
+	void* m_SubmissionEntries = nullptr;
+	size_t m_SubmissionEntriesSize = 0u;
+
+	// Pointers into the ring mappings
+	uint32_t* m_SqHead = nullptr;
+	uint32_t* m_SqTail = nullptr;
+	uint32_t* m_SqMask = nullptr;
+	uint32_t* m_SqArray = nullptr;
+	uint32_t* m_CqHead = nullptr;
+	uint32_t* m_CqTail = nullptr;
+	uint32_t* m_CqMask = nullptr;
+	void* m_Cqes = nullptr;
+
+	std::mutex m_Mutex;		// The ring may only be driven by one batch at a time
+
+	void setupRing(const uint32_t queueDepth);
+	void teardownRing() noexcept;
+};
+#endif
+
+
+/// Source for documents in remote storage (e.g. an object store) which can only be accessed through ranged requests, 
+/// each of which carries a large fixed latency. The user provides a function fetching a single byte range which is 
+/// used as follows:
+/// 
+/// - Small reads such as the header, image resources and layer records are served from a cache of fixed size blocks, 
+///   consecutive missing blocks being fetched with a single request.
+/// - Large reads such as a layers' channel data bypass the cache and are fetched directly.
+/// - Batches (which is how the channel data of many layers is requested at once) are coalesced into as few requests 
+///   as possible by merging ranges which are adjacent or separated by less than coalesceGap bytes. The resulting 
+///   requests are issued in parallel so the fetch function must be thread-safe.
+struct RangeRequestByteSource : public ByteSource
+{
+	using FetchFunction = std::function<void(char* buffer, const uint64_t offset, const uint64_t size)>;
+
+	struct Params
+	{
+		/// The granularity of the block cache
+		uint64_t blockSize;
+		/// The maximum amount of blocks held in the cache, the least recently used are evicted first. At least 2 blocks are cached
+		uint64_t cacheBlocks;
+		/// Ranges in a batch whose gap is at most this many bytes are fetched with a single request
+		uint64_t coalesceGap;
+		/// The maximum size of a single coalesced request
+		uint64_t maxRequestSize;
+		Params() : blockSize(1024u * 256u), cacheBlocks(64u), coalesceGap(1024u * 64u), maxRequestSize(1024u * 1024u * 64u) {};
+	};
+
+	struct Stats
+	{
+		uint64_t requests = 0u;
+		uint64_t bytesFetched = 0u;
+		uint64_t cacheHits = 0u;
+		uint64_t cacheMisses = 0u;
+	};
+
+	void read(char* buffer, const uint64_t offset, const uint64_t size) override;
+	void readBatch(std::span<const ReadRequest> requests) override;
+	uint64_t size() const noexcept override { return m_Size; };
+	bool prefersBatchedReads() const noexcept override { return true; };
+
+	/// Get the totals of the requests issued so far
+	Stats getStats() const;
+
+	/// \param fetchFunction function filling the buffer with size bytes starting at offset of the remote document
+	/// \param size the total size of the remote document, e.g. from a HEAD request
+	/// \param params settings for the block cache and the coalescing of requests
+	RangeRequestByteSource(FetchFunction fetchFunction, const uint64_t size, const Params params = Params());
+
+private:
+	FetchFunction m_FetchFunction;
+	uint64_t m_Size = 0u;
+	Params m_Params;
+
+	// LRU cache of blocks, the list is ordered from most to least recently used
+	using Block = std::pair<uint64_t, std::vector<uint8_t>>;
+	std::list<Block> m_Blocks;
+	std::unordered_map<uint64_t, std::list<Block>::iterator> m_BlockLookup;
+	mutable std::mutex m_CacheMutex;
+	/// Blocks currently being fetched by one of the readers, others needing them wait on m_FetchCondition rather than 
+	/// fetching them a second time. Guarded by m_CacheMutex
+	std::unordered_set<uint64_t> m_InFlightBlocks;
+	std::condition_variable m_FetchCondition;
+
+	Stats m_Stats;
+	mutable std::mutex m_StatsMutex;
+
+	/// Issue a single ranged request and record it in the stats
+	void fetch(char* buffer, const uint64_t offset, const uint64_t size);
+	/// Insert the block into the cache, evicting the least recently used block if full. The caller must hold m_CacheMutex
+	void insertBlock(const uint64_t index, std::vector<uint8_t>&& data);
+};
+
+
+/// Source consuming a non-seekable stream such as a pipe or stdin strictly front to back. Reads have to be (mostly) 
+/// in increasing order which the read path guarantees for such sources as it reads and decodes the channel image data 
+/// one layer at a time in file order. Data is only buffered from the most recent read onwards (plus retainSize bytes 
+/// before it to allow for small backwards jumps such as section padding) and regions which are skipped are consumed 
+/// without being buffered at all. Reads larger than retainSize go straight into the callers' buffer so e.g. the 
+/// channel image data of a layer is never held twice. Reading data which was already released is an error.
+/// 
+/// As the size of a stream is not generally known up front it may be omitted in which case running out of data 
+/// is only detected once we try to read past the end of the stream
+struct StreamByteSource : public ByteSource
+{
+	/// Function reading up to size bytes into the buffer, returning the amount of bytes read and 0 once the stream ended
+	using ReadFunction = std::function<uint64_t(char* buffer, const uint64_t size)>;
+
+	static constexpr uint64_t s_UnknownSize = (std::numeric_limits<uint64_t>::max)();
+
+	void read(char* buffer, const uint64_t offset, const uint64_t size) override;
+	void readBatch(std::span<const ReadRequest> requests) override;
+	uint64_t size() const noexcept override { return m_Size; };
+	bool isSeekable() const noexcept override { return false; };
+
+	/// The largest amount of bytes held in the buffer at any point
+	uint64_t getBufferHighWaterMark() const;
+
+	/// Read from the given function
+	StreamByteSource(ReadFunction readFunction, const uint64_t size = s_UnknownSize, const uint64_t retainSize = 1024u * 64u);
+	/// Read from the given file descriptor (e.g. a pipe or stdin), the descriptor is not closed on destruction
+	StreamByteSource(const int fileDescriptor, const uint64_t size = s_UnknownSize, const uint64_t retainSize = 1024u * 64u);
+	/// Read from the given stream which must outlive the source
+	StreamByteSource(std::istream& stream, const uint64_t size = s_UnknownSize, const uint64_t retainSize = 1024u * 64u);
+
+private:
+	ReadFunction m_ReadFunction;
+	uint64_t m_Size = 0u;
+	uint64_t m_RetainSize = 0u;
+
+	std::vector<uint8_t> m_Buffer;		// The data we consumed but did not yet release
+	uint64_t m_BufferOffset = 0u;		// The stream offset of the first byte in m_Buffer
+	uint64_t m_HighWaterMark = 0u;
+	mutable std::mutex m_Mutex;
+
+	/// Consume the stream until everything up to end is buffered, the caller must hold m_Mutex
+	void fill(const uint64_t end);
+	/// Consume size bytes from the stream straight into the given buffer bypassing m_Buffer, the caller must hold m_Mutex
+	void readInto(char* buffer, uint64_t size);
+	/// Consume and drop size bytes from the stream, the caller must hold m_Mutex and the buffer must be empty
+	void drop(uint64_t size);
+	/// Release all buffered data before the given offset, the caller must hold m_Mutex
+	void release(const uint64_t offset);
+};
+
+
+/// Source forwarding every read to a user provided function which receives the buffer to fill, the offset
+/// and the number of bytes to read. Calls to the function are serialized so it does not need to be thread-safe
+struct CallbackByteSource : public ByteSource
+{
+	using ReadFunction = std::function<void(char* buffer, const uint64_t offset, const uint64_t size)>;
+
+	void read(char* buffer, const uint64_t offset, const uint64_t size) override;
+	uint64_t size() const noexcept override { return m_Size; };
+
+	CallbackByteSource(ReadFunction readFunction, const uint64_t size);
+
+private:
+	ReadFunction m_ReadFunction;
+	uint64_t m_Size = 0u;
+	std::mutex m_Mutex;
+};
+
+
+PSAPI_NAMESPACE_END
@@ -39,7 +39,7 @@ void ByteStream::read(char* buffer, uint64_t size)
 	}
 
 	// Use memcpy to copy data from m_Buffer to the provided buffer
-	std::memcpy(buffer, m_Buffer.data() + m_Offset, size);
+	std::memcpy(buffer, data() + m_Offset, size);
 
 	m_Offset += size;
 }
@@ -60,27 +60,27 @@ void ByteStream::read(char* buffer, uint64_t offset, uint64_t size)
 	}
 
 	// Use memcpy to copy data from m_Buffer to the provided buffer
-	std::memcpy(buffer, m_Buffer.data() + offset, size);
+	std::memcpy(buffer, data() + offset, size);
 }
 
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-std::span<uint8_t> ByteStream::read(uint64_t size)
+std::span<const uint8_t> ByteStream::read(uint64_t size)
 {
 	PROFILE_FUNCTION();
 	if (m_Offset + size > m_Size)
 	{
 		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %" PRIu64 " but got %" PRIu64 " instead", m_Size, m_Offset + size);
 	}
-	return std::span<uint8_t>(m_Buffer.data() + m_Offset, size);
+	return std::span<const uint8_t>(data() + m_Offset, size);
 }
 
 
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-std::span<uint8_t> ByteStream::read(uint64_t offset, uint64_t size)
+std::span<const uint8_t> ByteStream::read(uint64_t offset, uint64_t size)
 {
 	PROFILE_FUNCTION();
 	if (offset > m_Size)
@@ -91,22 +91,65 @@ std::span<uint8_t> ByteStream::read(uint64_t offset, uint64_t size)
 	{
 		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %" PRIu64 " but got %" PRIu64 " instead", m_Size, m_Offset + size);
 	}
-	return std::span<uint8_t>(m_Buffer.data() + offset, size);
+	return std::span<const uint8_t>(data() + offset, size);
 }
 
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-ByteStream::ByteStream(File& document, const uint64_t offset, const uint64_t size)
+ByteStream::ByteStream(File& document, const uint64_t offset, const uint64_t size, const bool zeroCopy)
 {
 	PROFILE_FUNCTION();
+	m_Size = size;
+	m_FileOffset = offset;
+	if (zeroCopy && document.supportsView())
+	{
+		// The decompression routines only ever read from the spans we hand out so we can safely
+		// alias the read-only source and e.g. let the page cache serve the data directly
+		m_View = document.readViewFromOffset(offset, size);
+		m_IsView = true;
+		return;
+	}
 	{
 		PROFILE_SCOPE("Vector malloc");
 		m_Buffer = std::vector<uint8_t>(size);
 	}
-	m_Size = size;
 	document.readFromOffset(reinterpret_cast<char*>(m_Buffer.data()), offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+ByteStream::ByteStream(ByteSource& source, const uint64_t offset, const uint64_t size, const bool zeroCopy)
+{
+	PROFILE_FUNCTION();
+	if (offset + size > source.size())
+	{
+		PSAPI_LOG_ERROR("ByteStream", "Size %" PRIu64 " at offset %" PRIu64 " exceeds the source size of %" PRIu64 "", size, offset, source.size());
+	}
+	m_Size = size;
 	m_FileOffset = offset;
+	if (zeroCopy && source.supportsView())
+	{
+		m_View = source.view(offset, size);
+		m_IsView = true;
+		return;
+	}
+	{
+		PROFILE_SCOPE("Vector malloc");
+		m_Buffer = std::vector<uint8_t>(size);
+	}
+	source.read(reinterpret_cast<char*>(m_Buffer.data()), offset, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+ByteStream::ByteStream(std::vector<uint8_t>&& buffer, const uint64_t fileOffset)
+{
+	m_Buffer = std::move(buffer);
+	m_Size = m_Buffer.size();
+	m_FileOffset = fileOffset;
 }
 
 
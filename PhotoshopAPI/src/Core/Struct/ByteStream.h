@@ -20,7 +20,11 @@ PSAPI_NAMESPACE_BEGIN
 
 // A stream of binary data with its own internal offset and size markers.
 // It is meant to replace the read functionality in sections where we cannot dynamically 
-// read from the document itself. This object is meant to represent the binary stream for a single thread
+// read from the document itself. This object is meant to represent the binary stream for a single thread.
+// 
+// A ByteStream either owns a copy of the data or, if the document is contiguous in memory (memory mapped 
+// or an in-memory buffer) and zero-copy was requested, is a bounds-checked view into the document in which 
+// case the File must outlive the ByteStream. The spans returned from the read functions are therefore read-only.
 struct ByteStream
 {
 
@@ -34,18 +38,32 @@ struct ByteStream
 	// m_Offset variable 
 	void read(char* buffer, uint64_t offset, uint64_t size);
 
-	std::span<uint8_t> read(uint64_t size);
-	std::span<uint8_t> read(uint64_t offset, uint64_t size);
+	std::span<const uint8_t> read(uint64_t size);
+	std::span<const uint8_t> read(uint64_t offset, uint64_t size);
+
+	// Whether the ByteStream is a view into the document rather than owning its data
+	inline bool isView() const noexcept { return m_IsView; };
 
 	ByteStream() = default;
-	// Initialize a ByteStream from a given document and read the size into the ByteStream object
-	ByteStream(File& document, const uint64_t offset, const uint64_t size);
+	// Initialize a ByteStream from a given document. If zeroCopy is true and the document supports views
+	// we only hold a view into its data, otherwise the size is read into the ByteStream object
+	ByteStream(File& document, const uint64_t offset, const uint64_t size, const bool zeroCopy = true);
+	// Initialize a ByteStream directly from a source rather than through a document, with the same semantics
+	// as the above. If we end up with a view the source must outlive the ByteStream
+	ByteStream(ByteSource& source, const uint64_t offset, const uint64_t size, const bool zeroCopy = true);
+	// Initialize a ByteStream taking ownership of data which was already read from the given file offset
+	ByteStream(std::vector<uint8_t>&& buffer, const uint64_t fileOffset);
 
 private:
 	std::vector<uint8_t> m_Buffer;
+	std::span<const uint8_t> m_View;	// View into the document, only valid if m_IsView is true
+	bool m_IsView = false;
 	uint64_t m_Offset = 0u;	// Internal offset for our data
 	uint64_t m_FileOffset = 0u; // The location in the file we are at
 	uint64_t m_Size = 0u;	// Total size of the buffer
+
+	// Get a pointer to the start of our data regardless of whether we own it or not
+	inline const uint8_t* data() const noexcept { return m_IsView ? m_View.data() : m_Buffer.data(); };
 };
 
 
@@ -1,21 +1,87 @@
 #include "File.h"
+#include "ByteStream.h"
 
 #include "Macros.h"
 #include "Profiling/Perf/Instrumentor.h"
 
+#include <algorithm>
+
 PSAPI_NAMESPACE_BEGIN
 
+
+namespace
+{
+	// Source serving reads of a region of another document from a ByteStream while keeping the offsets of 
+	// that document. If the document supports views the whole region is a zero-copy view, otherwise we fetch 
+	// it in blocks as parsing progresses so we do not pull in e.g. all the channel image data following the 
+	// layer records just to parse the records. The blocks start out small and double on every fetch so both
+	// the number of fetches and the amount of data read past what is parsed stay small. 
+	// Not thread-safe, see File(File&, ...)
+	struct RegionByteSource : public ByteSource
+	{
+		static constexpr uint64_t s_MinReadAheadSize = 4096u;
+		static constexpr uint64_t s_MaxReadAheadSize = 1024u * 1024u * 4u;
+
+		void read(char* buffer, const uint64_t offset, const uint64_t size) override
+		{
+			if (offset < m_RegionOffset) [[unlikely]]
+			{
+				PSAPI_LOG_ERROR("File", "Cannot read from offset %" PRIu64 " as it lies before the start of the region at %" PRIu64 "", offset, m_RegionOffset);
+			}
+			if (offset < m_StreamOffset || offset + size > m_StreamOffset + m_Stream.getSize())
+			{
+				const uint64_t fetchSize = std::min(std::max(size, m_ReadAheadSize), m_RegionEnd - offset);
+				m_Stream = ByteStream(m_Document, offset, fetchSize);
+				m_StreamOffset = offset;
+				m_ReadAheadSize = std::min(m_ReadAheadSize * 2u, s_MaxReadAheadSize);
+			}
+			m_Stream.read(buffer, offset - m_StreamOffset, size);
+		}
+		uint64_t size() const noexcept override { return m_RegionEnd; };
+		bool supportsView() const noexcept override { return m_Document.supportsView(); };
+		std::span<const uint8_t> view(const uint64_t offset, const uint64_t size) const override
+		{
+			return m_Document.readViewFromOffset(offset, size);
+		}
+
+		RegionByteSource(File& document, const uint64_t offset, const uint64_t size) : m_Document(document)
+		{
+			m_RegionOffset = offset;
+			m_RegionEnd = offset + size;
+			m_StreamOffset = offset;
+			if (document.supportsView())
+			{
+				m_Stream = ByteStream(document, offset, size);
+			}
+		}
+
+	private:
+		File& m_Document;
+		ByteStream m_Stream;			// The currently fetched part of the region
+		uint64_t m_StreamOffset = 0u;	// The document offset the start of m_Stream maps to
+		uint64_t m_ReadAheadSize = s_MinReadAheadSize;
+		uint64_t m_RegionOffset = 0u;
+		uint64_t m_RegionEnd = 0u;
+	};
+}
+
+
 // --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
 void File::read(char* buffer, uint64_t size)
 {
-	std::lock_guard<std::mutex> guard(m_Mutex);
+	// Region cursors are private to the thread parsing them so there is nothing to synchronize with
+	std::unique_lock<std::mutex> guard(m_Mutex, std::defer_lock);
+	if (!m_IsRegion)
+	{
+		guard.lock();
+	}
 	if (m_Offset + size > m_Size) [[unlikely]]
 		{
 			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, m_Offset, m_Size);
 		}
 
-	m_Document.read(buffer, size);
+	m_Source->read(buffer, m_Offset, size);
 	m_Offset += size;
 }
 
@@ -29,9 +95,86 @@ void File::readFromOffset(char* buffer, const uint64_t offset, const uint64_t si
 	{
 		PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, offset, m_Size);
 	}
-	// We use the memory-mapped file version here to access in parallel
-	const uint8_t* srcPtr = m_DocumentMMap.data() + offset;
-	std::memcpy(buffer, srcPtr, size);
+	// The sources are required to be thread-safe so we can access them in parallel without locking
+	m_Source->read(buffer, offset, size);
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::readBatchFromOffsets(std::span<const ByteSource::ReadRequest> requests)
+{
+	PROFILE_FUNCTION();
+	for (const auto& request : requests)
+	{
+		if (request.offset + request.size > m_Size) [[unlikely]]
+		{
+			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", request.size, request.offset, m_Size);
+		}
+	}
+	m_Source->readBatch(requests);
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::advise(const uint64_t offset, const uint64_t size, const ByteSource::Advice advice)
+{
+	if (!m_AdviseResidency || !m_Source || offset + size > m_Size)
+	{
+		return;
+	}
+	if (m_Source->advise(offset, size, advice))
+	{
+		if (advice == ByteSource::Advice::WillNeed)
+		{
+			m_PrefetchCount += 1u;
+			m_PrefetchBytes += size;
+		}
+		else
+		{
+			m_ReleaseCount += 1u;
+			m_ReleaseBytes += size;
+		}
+	}
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::setResidencyHints(const bool enabled, const uint32_t prefetchLayers) noexcept
+{
+	m_AdviseResidency = enabled;
+	m_PrefetchLayers = prefetchLayers;
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+File::ResidencyCounters File::getResidencyCounters() const noexcept
+{
+	ResidencyCounters counters;
+	counters.prefetchCount = m_PrefetchCount;
+	counters.prefetchBytes = m_PrefetchBytes;
+	counters.releaseCount = m_ReleaseCount;
+	counters.releaseBytes = m_ReleaseBytes;
+	return counters;
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+std::span<const uint8_t> File::readViewFromOffset(const uint64_t offset, const uint64_t size) const
+{
+	if (!supportsView()) [[unlikely]]
+	{
+		PSAPI_LOG_ERROR("File", "Cannot create a view into the document as its source is not contiguous in memory");
+	}
+	if (offset + size > m_Size) [[unlikely]]
+	{
+		PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, offset, m_Size);
+	}
+	return m_Source->view(offset, size);
 }
 
 
@@ -40,13 +183,102 @@ void File::readFromOffset(char* buffer, const uint64_t offset, const uint64_t si
 void File::write(std::span<uint8_t> buffer)
 {
 	std::lock_guard<std::mutex> guard(m_Mutex);
-	m_Size += buffer.size();
-	m_Offset += buffer.size();
-	m_Document.write(reinterpret_cast<char*>(buffer.data()), buffer.size());
+	const uint64_t size = buffer.size();
+
+	// If we seeked outside of the range covered by the write buffer we must first flush it as it
+	// only ever represents a contiguous region of the file
+	if (m_Offset < m_WriteBufferOffset || m_Offset > m_WriteBufferOffset + m_WriteBuffer.size())
+	{
+		flushWriteBuffer();
+	}
+
+	if (size >= m_WriteBufferSize)
+	{
+		// Large writes such as compressed channel data go straight to the sink as buffering them would
+		// only add another copy
+		flushWriteBuffer();
+		PROFILE_SCOPE("File::write FileIO");
+		m_Sink->write(buffer, m_Offset);
+	}
+	else
+	{
+		uint64_t bufferPos = m_Offset - m_WriteBufferOffset;
+		if (bufferPos + size > m_WriteBufferSize)
+		{
+			flushWriteBuffer();
+			bufferPos = 0u;
+		}
+		// This may either append to or overwrite previously buffered data, the latter being the
+		// case when going back to fill out a size marker
+		if (bufferPos + size > m_WriteBuffer.size())
+		{
+			m_WriteBuffer.resize(bufferPos + size);
+		}
+		std::memcpy(m_WriteBuffer.data() + bufferPos, buffer.data(), size);
+	}
+
+	m_Offset += size;
+	m_Size = std::max(m_Size, m_Offset);
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::writeToOffset(std::span<const uint8_t> buffer, const uint64_t offset)
+{
+	PROFILE_FUNCTION();
+	const uint64_t size = buffer.size();
+	{
+		std::lock_guard<std::mutex> guard(m_Mutex);
+		// Any pending data overlapping our region must be written first as it would otherwise overwrite our data once flushed
+		if (offset < m_WriteBufferOffset + m_WriteBuffer.size() && offset + size > m_WriteBufferOffset)
+		{
+			flushWriteBuffer();
+		}
+		m_Size = std::max(m_Size, offset + size);
+	}
+	// The sinks are required to support concurrent writes to non-overlapping regions so we do not hold the lock here
+	m_Sink->write(buffer, offset);
 }
 
 
-// -------------------------------------------------------------------------------- 
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::flush()
+{
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	flushWriteBuffer();
+	m_Sink->flush();
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::reserve(const uint64_t size)
+{
+	if (m_Sink)
+	{
+		m_Sink->reserve(size);
+	}
+}
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::flushWriteBuffer()
+{
+	if (!m_WriteBuffer.empty())
+	{
+		PROFILE_SCOPE("File::flushWriteBuffer FileIO");
+		m_Sink->write(m_WriteBuffer, m_WriteBufferOffset);
+		// This does not release the memory so the buffer is reused for the next block
+		m_WriteBuffer.clear();
+	}
+	m_WriteBufferOffset = m_Offset;
+}
+
+
+// --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
 void File::skip(int64_t size)
 {
@@ -57,9 +289,10 @@ void File::skip(int64_t size)
 	}
 	if (m_Offset + size > m_Size)
 	{
-		PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be skipped from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, m_Offset, m_Size);
+		PSAPI_LOG_ERROR("File", "Size %" PRId64 " cannot be skipped from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, m_Offset, m_Size);
 	}
-	m_Document.ignore(size);
+	// We only ever read through the source on demand so skipping is just moving our marker. Any pending 
+	// writes are unaffected as the write buffer tracks its own offset
 	m_Offset += size;
 }
 
@@ -79,7 +312,6 @@ void File::setOffset(const uint64_t offset)
 		return;
 	}
 	m_Offset = offset;
-	m_Document.seekg(offset, std::ios::beg);
 }
 
 
@@ -93,11 +325,7 @@ void File::setOffsetAndRead(char* buffer, const uint64_t offset, const uint64_t
 		PSAPI_LOG_ERROR("File", "Cannot set offset to %" PRIu64 " as it would exceed the file size of %" PRIu64 ".", offset, m_Size);
 		return;
 	}
-	if (offset != m_Offset)
-	{
-		m_Offset = offset;
-		m_Document.seekg(offset, std::ios::beg);
-	}
+	m_Offset = offset;
 
 	if (m_Offset + size > m_Size) [[unlikely]]
 	{
@@ -105,7 +333,7 @@ void File::setOffsetAndRead(char* buffer, const uint64_t offset, const uint64_t
 	}
 	{
 		PROFILE_SCOPE("File::setOffsetAndRead FileIO");
-		m_Document.read(buffer, size);
+		m_Source->read(buffer, m_Offset, size);
 	}
 	m_Offset += size;
 }
@@ -122,16 +350,32 @@ File::File(std::filesystem::path file, const FileParams params)
 		std::filesystem::create_directories(file.parent_path());
 		PSAPI_LOG("Created directory '%s' as it didnt exist", file.parent_path().string().c_str());
 	}
-	m_Offset = 0;
-	m_Size = 0;
 
 	// Check if the file exists and otherwise create it
 	if (params.doRead == true)
 	{
 		if (std::filesystem::exists(file))
 		{
-			m_Document.open(file, std::ios::binary | std::fstream::in);
-			m_DocumentMMap = mio::ummap_source(file.string());
+			if (params.useIoUring)
+			{
+#if defined(PSAPI_USE_IO_URING) && defined(__linux__)
+				m_Source = std::make_unique<IoUringByteSource>(file, params.ioUringQueueDepth);
+#else
+				PSAPI_LOG_WARNING("File", "io_uring reads were requested but the PhotoshopAPI was not compiled with PSAPI_USE_IO_URING, memory mapping the file instead");
+#endif
+			}
+			if (!m_Source)
+			{
+				m_Source = std::make_unique<MappedFileByteSource>(file);
+			}
+			m_Size = m_Source->size();
+			setResidencyHints(params.adviseResidency, params.prefetchLayers);
+			setLazyChannels(params.lazyChannels);
+			setMetadataOnly(params.metadataOnly);
+			setLayerFilter(params.layerFilter);
+			setDecodeMemoryBudget(params.decodeMemoryBudget);
+			setMergedImageData(params.mergedImageData);
+			setLayerReadCallback(params.onLayerRead);
 		}
 		else
 		{
@@ -140,38 +384,100 @@ File::File(std::filesystem::path file, const FileParams params)
 	}
 	else
 	{
-		if (std::filesystem::exists(file))
+		if (std::filesystem::exists(file) && params.forceOverwrite)
 		{
-			if (params.forceOverwrite)
-			{
-				std::filesystem::remove(file);
-				PSAPI_LOG("File", "Removed file %s", file.string().c_str());
-			}
-			m_Document.open(file, std::ios::binary | std::fstream::out | std::fstream::trunc);
-			PSAPI_LOG("File", "Created file %s", file.string().c_str());
+			std::filesystem::remove(file);
+			PSAPI_LOG("File", "Removed file %s", file.string().c_str());
+		}
+		if (params.directIO)
+		{
+			m_Sink = std::make_unique<DirectFileByteSink>(file, params.directIOAlignment);
+		}
+		else if (params.memoryMapOutput)
+		{
+			m_Sink = std::make_unique<MappedFileByteSink>(file);
 		}
 		else
 		{
-			m_Document.open(file, std::ios::binary | std::fstream::out | std::fstream::trunc);
-			PSAPI_LOG("File", "Created file %s", file.string().c_str());
+			m_Sink = std::make_unique<FileByteSink>(file);
 		}
+		PSAPI_LOG("File", "Created file %s", file.string().c_str());
+
+		m_WriteBufferSize = params.writeBufferSize;
+		m_WriteBuffer.reserve(m_WriteBufferSize);
+	}
+
+	m_FilePath = file;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+File::File(std::unique_ptr<ByteSource> source)
+{
+	if (!source)
+	{
+		PSAPI_LOG_ERROR("File", "Unable to construct a File from an empty source");
 	}
+	m_Source = std::move(source);
+	m_Size = m_Source->size();
+}
 
-	if (m_Document.is_open())
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+File::File(std::unique_ptr<ByteSink> sink, const FileParams params)
+{
+	if (!sink)
 	{
-		// Get the size of the file
-		m_Document.seekg(0, std::ios::end);
-		m_Size = static_cast<uint64_t>(m_Document.tellg());
-		m_Document.seekg(0, std::ios::beg);
+		PSAPI_LOG_ERROR("File", "Unable to construct a File from an empty sink");
 	}
-	else
+	m_Sink = std::move(sink);
+	m_WriteBufferSize = params.writeBufferSize;
+	m_WriteBuffer.reserve(m_WriteBufferSize);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+File::File(File& document, const uint64_t offset, const uint64_t size)
+{
+	if (!document.m_Source)
 	{
-		// Handle file open error
-		PSAPI_LOG_ERROR("File", "Failed to open file: %s", file.string().c_str());
-	}	
+		PSAPI_LOG_ERROR("File", "Unable to construct a region cursor over a document which is not open for reading");
+	}
+	if (offset + size > document.m_Size)
+	{
+		PSAPI_LOG_ERROR("File", "Region of size %" PRIu64 " at offset %" PRIu64 " exceeds the file size of %" PRIu64 "", size, offset, document.m_Size);
+	}
+	m_Source = std::make_unique<RegionByteSource>(document, offset, size);
+	m_Size = m_Source->size();
+	m_Offset = offset;
+	m_FilePath = document.m_FilePath;
+	m_IsRegion = true;
+}
 
-	m_FilePath = file;
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+File::~File()
+{
+	if (m_Sink)
+	{
+		// We cannot let any exceptions escape the destructor so we just report failures, call flush() 
+		// explicitly to handle these
+		std::lock_guard<std::mutex> guard(m_Mutex);
+		try
+		{
+			flushWriteBuffer();
+			m_Sink->flush();
+		}
+		catch (const std::exception& e)
+		{
+			PSAPI_LOG_WARNING("File", "Failed to flush pending data on destruction: %s", e.what());
+		}
+	}
 }
 
 
-PSAPI_NAMESPACE_END
\ No newline at end of file
+PSAPI_NAMESPACE_END
@@ -2,15 +2,20 @@
 
 #include "Macros.h"
 #include "Logger.h"
+#include "ByteSource.h"
+#include "ByteSink.h"
+#include "LayerFilter.h"
+#include "MemoryBudget.h"
 
+#include <atomic>
 #include <filesystem>
-#include <fstream>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <vector>
 #include <cstring>
 
-#include <mio/mmap.hpp>
-
 #if (__cplusplus < 202002L)
 #include "tcb_span.hpp"
 #else
@@ -24,14 +29,94 @@
 PSAPI_NAMESPACE_BEGIN
 
 
-/// Thread-safe read and write by using a std::mutex to block any reading operations
+struct LayerRecord;
+struct ChannelImageData;
+
+
+/// Thread-safe read and write by using a std::mutex to block any reading operations.
+/// 
+/// A File either reads from a ByteSource or writes to a ByteSink. When constructed from a path these are a memory
+/// mapped file and a file on disk respectively but any other source or sink (such as an in-memory buffer) can be 
+/// passed in to read or write documents without ever touching the disk.
+/// 
+/// Writes are collected in a user-space buffer and only issued to the sink in large blocks once the buffer is full, 
+/// on calls to flush() or when the File goes out of scope. Seeking back to an already written position 
+/// (e.g. to fill in a section size marker) is supported and patches either the pending buffer or the sink itself.
 struct File
 {
+	/// Called once the ChannelImageData of a layer was read with the index of the layer within the layer records, 
+	/// the record itself and its channels. See FileParams::onLayerRead
+	using LayerReadCallback = std::function<void(size_t layerIndex, const LayerRecord& layerRecord, ChannelImageData& channelImageData)>;
+
 	struct FileParams
 	{
 		bool doRead;
 		bool forceOverwrite;
-		FileParams() : doRead(true), forceOverwrite(false) {};
+		/// The size of the user-space write buffer in bytes, writes larger than this bypass the buffer.
+		/// Only applies to files opened for writing
+		uint64_t writeBufferSize;
+		/// Read through io_uring rather than a memory mapping, which allows the channel image data of many layers
+		/// to be requested at once. This is beneficial on high-latency storage such as network or cloud block devices.
+		/// Only has an effect on Linux when compiled with PSAPI_USE_IO_URING, otherwise the file is memory mapped
+		bool useIoUring;
+		/// The amount of reads kept in flight at once when useIoUring is set
+		uint32_t ioUringQueueDepth;
+		/// Write through a memory mapping of the output rather than through regular writes. The file is preallocated 
+		/// once the size of the bulk of the data is known and data is copied straight into place. Only applies to 
+		/// files opened for writing
+		bool memoryMapOutput;
+		/// Write with direct I/O bypassing the page cache, which keeps multi-gigabyte outputs from evicting data 
+		/// other processes are about to read. Only applies to files opened for writing and takes precedence
+		/// over memoryMapOutput
+		bool directIO;
+		/// The block alignment the device requires for direct I/O, must be a power of two
+		uint64_t directIOAlignment;
+		/// Give the source hints about which parts of the document are about to be read and which ones were already
+		/// decoded. For memory mapped files this prefetches the channel data of upcoming layers and releases that of 
+		/// decoded layers, keeping the resident memory bounded rather than leaving the whole document mapped in.
+		/// Only applies to files opened for reading
+		bool adviseResidency;
+		/// How many layers ahead of the ones currently being decoded to prefetch if adviseResidency is set
+		uint32_t prefetchLayers;
+		/// Defer decoding the channel image data until a channel is first accessed rather than decoding every layer 
+		/// up front. The channels only remember where their data lives and keep the source alive until they are
+		/// decoded so the File itself may go out of scope. Only applies to files opened for reading
+		bool lazyChannels;
+		/// Only read the document structure (layer records, tagged blocks, mask parameters) and skip the channel 
+		/// image data entirely. The resulting channels report their extents, size and compression but hold no image 
+		/// data so such a document cannot be written back out. Takes precedence over lazyChannels and only applies 
+		/// to files opened for reading
+		bool metadataOnly;
+		/// Only decode the image data of the layers and channels matching the filter, all other layers only have their
+		/// metadata read. Only applies to files opened for reading
+		std::optional<LayerFilter> layerFilter;
+		/// Bound the memory held by the layers decoded at once. A layer only starts decoding once its compressed data
+		/// and decoded channels fit within the budget, the same budget may be shared between documents read 
+		/// concurrently. Decoding is unbounded if this is empty. Only applies to files opened for reading and not to 
+		/// channels decoded lazily
+		std::shared_ptr<MemoryBudget> decodeMemoryBudget;
+		/// Additionally decode the merged composite stored at the end of the document into PhotoshopFile::m_ImageData.
+		/// Only applies to files opened for reading
+		bool mergedImageData;
+		/// Invoked as soon as the channels of a layer are read, while the other layers are still being decoded. This
+		/// allows processing the image data of a layer without waiting for the whole document. The callback is 
+		/// invoked concurrently from the threads decoding the layers and must therefore be thread-safe. The channels
+		/// should only be read from, any channel extracted here is missing from the document afterwards. Only applies
+		/// to files opened for reading
+		LayerReadCallback onLayerRead;
+		FileParams() : doRead(true), forceOverwrite(false), writeBufferSize(1024u * 1024u * 8u), useIoUring(false), ioUringQueueDepth(64u), 
+			memoryMapOutput(false), directIO(false), directIOAlignment(4096u), adviseResidency(false), prefetchLayers(4u), lazyChannels(false), 
+			metadataOnly(false), layerFilter(std::nullopt), decodeMemoryBudget(nullptr), 
+			mergedImageData(false), onLayerRead(nullptr) {};
+	};
+
+	/// Running totals of the residency hints issued through advise() which were applied by the source
+	struct ResidencyCounters
+	{
+		uint64_t prefetchCount = 0u;
+		uint64_t prefetchBytes = 0u;
+		uint64_t releaseCount = 0u;
+		uint64_t releaseBytes = 0u;
 	};
 
 	// Use this mutex as well for locking throughout the application when IO functions
@@ -44,22 +129,158 @@ struct File
 	// --------------------------------------------------------------------------------
 	void read(char* buffer, uint64_t size);
 	
-	/// Read a specified number of bytes using a memory mapped file representation meaning
+	/// Read a specified number of bytes directly from the underlying source meaning
 	/// this function is safe to call from any thread. This does not move around the 
 	/// internal offset marker unlike setOffsetAndRead.
 	// --------------------------------------------------------------------------------
 	// --------------------------------------------------------------------------------
 	void readFromOffset(char* buffer, const uint64_t offset, const uint64_t size);
 
-	/// Write n bytes to the file from the input span.
+	/// Return a read-only view into the underlying source (e.g. the memory mapped file) without copying
+	/// any data. Like readFromOffset this is safe to call from any thread and does not move the
+	/// internal offset marker. The view is only valid for as long as the File object is alive.
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	std::span<const uint8_t> readViewFromOffset(const uint64_t offset, const uint64_t size) const;
+
+	/// Read all the given requests directly from the underlying source, this is safe to call from any thread and
+	/// does not move the internal offset marker. Sources which prefersBatchedReads() may keep all of these in flight at once
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void readBatchFromOffsets(std::span<const ByteSource::ReadRequest> requests);
+
+	/// Hint to the source how the given range will be accessed next. This is a no-op unless residency hints were 
+	/// enabled through FileParams::adviseResidency or setResidencyHints(). Safe to call from any thread
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void advise(const uint64_t offset, const uint64_t size, const ByteSource::Advice advice);
+
+	/// Enable or disable residency hints, prefetchLayers controls how many layers ahead we prefetch
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void setResidencyHints(const bool enabled, const uint32_t prefetchLayers = 4u) noexcept;
+
+	/// Whether residency hints are enabled and how far ahead to prefetch
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline bool adviseResidency() const noexcept { return m_AdviseResidency; }
+	inline uint32_t prefetchLayers() const noexcept { return m_PrefetchLayers; }
+
+	/// Enable or disable lazy decoding of the channel image data, see FileParams::lazyChannels
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline void setLazyChannels(const bool enabled) noexcept { m_LazyChannels = enabled; }
+
+	/// Whether the channel image data should be decoded lazily, this is only possible if the source is seekable
+	/// and otherwise we fall back to decoding the channels as they are read
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline bool lazyChannels() const noexcept { return m_LazyChannels && isSeekable(); }
+
+	/// Whether the underlying source may be read at arbitrary offsets in any order, see ByteSource::isSeekable()
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline bool isSeekable() const noexcept { return m_Source && m_Source->isSeekable(); }
+
+	/// Enable or disable reading only the metadata of the document, see FileParams::metadataOnly
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline void setMetadataOnly(const bool enabled) noexcept { m_MetadataOnly = enabled; }
+	inline bool metadataOnly() const noexcept { return m_MetadataOnly; }
+
+	/// Set the filter restricting which layers and channels get decoded, see FileParams::layerFilter
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline void setLayerFilter(std::optional<LayerFilter> filter) { m_LayerFilter = std::move(filter); }
+
+	/// Get the filter restricting which layers and channels get decoded, nullptr if all of them are decoded
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline const LayerFilter* getLayerFilter() const noexcept { return m_LayerFilter.has_value() ? &m_LayerFilter.value() : nullptr; }
+
+	/// Set the budget bounding the memory of the layers decoded at once, see FileParams::decodeMemoryBudget
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline void setDecodeMemoryBudget(std::shared_ptr<MemoryBudget> budget) noexcept { m_DecodeMemoryBudget = std::move(budget); }
+
+	/// Get the budget bounding the memory of the layers decoded at once, its highWaterMark() reports the largest
+	/// amount of memory reserved at once. nullptr if decoding is unbounded
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline MemoryBudget* getDecodeMemoryBudget() const noexcept { return m_DecodeMemoryBudget.get(); }
+
+	/// Set the callback invoked as soon as the channels of a layer are read, see FileParams::onLayerRead
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline void setLayerReadCallback(LayerReadCallback callback) { m_LayerReadCallback = std::move(callback); }
+
+	/// Get the callback invoked as soon as the channels of a layer are read, nullptr if none was set
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline const LayerReadCallback* getLayerReadCallback() const noexcept { return m_LayerReadCallback ? &m_LayerReadCallback : nullptr; }
+
+	/// Enable or disable decoding the merged composite of the document, see FileParams::mergedImageData
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline void setMergedImageData(const bool enabled) noexcept { m_MergedImageData = enabled; }
+	inline bool mergedImageData() const noexcept { return m_MergedImageData; }
+
+	/// Get shared ownership of the source the document is read from, e.g. to read from it after the File is gone.
+	/// This is empty for files opened for writing
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline std::shared_ptr<ByteSource> getSource() const noexcept { return m_Source; }
+
+	/// Get the totals of the residency hints applied so far
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	ResidencyCounters getResidencyCounters() const noexcept;
+
+	/// Check whether the underlying source benefits from many reads being issued at once through readBatchFromOffsets
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline bool prefersBatchedReads() const noexcept { return m_Source && m_Source->prefersBatchedReads(); }
+
+	/// Check whether the document is read from a source which is contiguous in memory such as a memory
+	/// mapping or an in-memory buffer, only then readViewFromOffset may be called
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline bool supportsView() const noexcept { return m_Source && m_Source->supportsView(); }
+
+	/// Write n bytes to the file from the input span at the current offset. The data is buffered 
+	/// and only guaranteed to be in the sink after calling flush()
 	// --------------------------------------------------------------------------------
 	// --------------------------------------------------------------------------------
 	void write(std::span<uint8_t> buffer);
 
 
+	/// Write n bytes to the file at the given offset without moving the internal offset marker. Unlike write() 
+	/// this is safe to call from multiple threads for distinct, non-overlapping regions and goes directly to the sink.
+	/// Regions beyond the current end of the file are legal and extend the file, it is up to the caller to make 
+	/// sure any gaps get filled.
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void writeToOffset(std::span<const uint8_t> buffer, const uint64_t offset);
+
+
+	/// Write out any pending data in the write buffer to the sink. This is called automatically 
+	/// on destruction of the File
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void flush();
+
+
+	/// Hint that the document will be at least the given size in bytes, allowing the sink to preallocate 
+	/// storage. Has no effect on files opened for reading
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void reserve(const uint64_t size);
+
+
 	/// Skip n bytes in the file and increment our position marker, checks if the offset 
-	/// is possible or if it would exceed the file size. Note: this is a uint64_t
-	/// so skipping backwards is legal
+	/// is possible or if it would exceed the file size. This is pure offset bookkeeping and never 
+	/// touches the underlying source, so skipping unparsed regions such as embedded smart object 
+	/// data is O(1) regardless of their size. Skipping zero or a negative amount of bytes is a no-op
 	// --------------------------------------------------------------------------------
 	// --------------------------------------------------------------------------------
 	void skip(int64_t size);
@@ -91,7 +312,8 @@ struct File
 	inline uint64_t getSize() const noexcept { return m_Size; }
 
 
-	/// Return the path of the file associated with the File object
+	/// Return the path of the file associated with the File object, this is empty for 
+	/// Files constructed from a ByteSource or ByteSink
 	// --------------------------------------------------------------------------------
 	// --------------------------------------------------------------------------------
 	inline std::filesystem::path getPath() const noexcept { return m_FilePath; };
@@ -103,13 +325,56 @@ struct File
 	// --------------------------------------------------------------------------------
 	File(std::filesystem::path file, const FileParams params = FileParams());
 
+	/// Initialize our File object for reading from the given source
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	File(std::unique_ptr<ByteSource> source);
+
+	/// Initialize our File object for writing to the given sink, only the writeBufferSize of the 
+	/// params is taken into account
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	File(std::unique_ptr<ByteSink> sink, const FileParams params = FileParams());
+
+	/// Initialize a read-only cursor over the region [offset, offset + size) of another document which keeps
+	/// the offset space of that document, i.e. getOffset() still reports absolute file offsets. The region is 
+	/// fetched once in bulk (or viewed directly if the document supports views) rather than field by field 
+	/// from the document. Such a cursor is meant to be used exclusively by a single thread and does therefore
+	/// not lock on reads, the document must outlive it.
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	File(File& document, const uint64_t offset, const uint64_t size);
+
+	~File();
+
 
 private:
 	std::filesystem::path m_FilePath;
-	std::fstream m_Document;	// The file stream that represents our document
-	mio::ummap_source m_DocumentMMap;
-	uint64_t m_Size;			// The total size of the document
-	uint64_t m_Offset;			// The current document offset.
+	std::shared_ptr<ByteSource> m_Source;	// Where we read our document from, only valid when reading. Shared with lazily decoded channels
+	std::unique_ptr<ByteSink> m_Sink;		// Where we write our document to, only valid when writing
+	uint64_t m_Size = 0u;					// The total size of the document
+	uint64_t m_Offset = 0u;					// The current document offset.
+	bool m_IsRegion = false;				// Whether we are a single-threaded cursor over another document
+
+	bool m_AdviseResidency = false;
+	uint32_t m_PrefetchLayers = 4u;
+	bool m_LazyChannels = false;
+	bool m_MetadataOnly = false;
+	std::optional<LayerFilter> m_LayerFilter;
+	std::shared_ptr<MemoryBudget> m_DecodeMemoryBudget;
+	bool m_MergedImageData = false;
+	LayerReadCallback m_LayerReadCallback;
+	std::atomic<uint64_t> m_PrefetchCount = 0u;
+	std::atomic<uint64_t> m_PrefetchBytes = 0u;
+	std::atomic<uint64_t> m_ReleaseCount = 0u;
+	std::atomic<uint64_t> m_ReleaseBytes = 0u;
+
+	std::vector<uint8_t> m_WriteBuffer;		// Pending data which has not yet been written to the sink
+	uint64_t m_WriteBufferSize = 0u;		// The maximum size of m_WriteBuffer before it gets flushed
+	uint64_t m_WriteBufferOffset = 0u;		// The file offset the first byte of m_WriteBuffer maps to
+
+	/// Write the pending buffer to the sink, the caller is expected to hold m_Mutex
+	void flushWriteBuffer();
 };
 
 PSAPI_NAMESPACE_END
\ No newline at end of file
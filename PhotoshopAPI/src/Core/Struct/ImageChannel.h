@@ -9,11 +9,19 @@
 
 #include "blosc2.h"
 
+#include <atomic>
 #include <vector>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <functional>
+#include <optional>
 #include <random>
 #include <execution>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <span>
 
 
 #define __STDC_FORMAT_MACROS 1
@@ -23,22 +31,40 @@
 PSAPI_NAMESPACE_BEGIN
 
 
+template <typename T>
+struct ChannelBands;
+
+
 /// A generic Image Channel that is used by both the PhotoshopFile and LayeredFile, being moved between these two
 /// It is entirely valid to have each channel have a different compression method, width and height. We only
 /// store the image data in here but do not deal with reading or writing it. Ownership of the image data belongs
 /// to this struct and gets freed on destruction or extraction
+/// 
+/// A channel may also be constructed lazily from a decoder in which case the image data is only decoded (and
+/// compressed into its in-memory representation) on first access
 struct ImageChannel
 {
+	/// Function decoding the channel into the given buffer which holds m_OrigByteSize bytes
+	using LazyDecoder = std::function<void(std::span<uint8_t> buffer)>;
+	/// Function decoding only the given region of the channel into the buffer which holds region.width * region.height pixels
+	using RegionDecoder = std::function<void(std::span<uint8_t> buffer, const ChannelRegion& region)>;
+
 	/// The size of each sub-chunk in the super-chunk. For more information about what a chunk and super-chunk is
 	/// please refer to the c-blosc2 documentation
 	static const uint64_t m_ChunkSize = 16384 * 16384;
+	/// The default size in bytes of the scratch buffer used when iterating the channel in bands
+	static const uint64_t m_BandScratchSize = 16 * 1024 * 1024;
 	/// This does not indicate the compression method of the channel in memory 
 	/// but rather the compression method it writes the PhotoshopFile with
 	Enum::Compression m_Compression = Enum::Compression::Raw;
 	/// Information about what channel this actually is
 	Enum::ChannelIDInfo m_ChannelID = { Enum::ChannelID::Red, 1 };
 	/// The size of the original (uncompressed) data in bytes
-	uint64_t m_OrigByteSize = 0u;	
+	uint64_t m_OrigByteSize = 0u;
+	/// A 64-bit hash (see hash64()) of the compressed bytes, including the compression marker, this channel was read
+	/// from. Identical channel data in the file yields an identical hash across reads, making it suitable as a key for
+	/// caches and incremental pipelines. Only set for channels read eagerly from a file
+	std::optional<uint64_t> m_CompressedHash = std::nullopt;
 
 
 	/// Extract the data from the image channel and invalidate it (can only be called once). 
@@ -49,6 +75,12 @@ struct ImageChannel
 	template <typename T>
 	std::vector<T> extractData() {
 		PROFILE_FUNCTION();
+		// As the data is handed out we can skip compressing it into our own representation
+		if (auto decoded = decodeLazy<T>(false))
+		{
+			m_wasFreed = true;
+			return std::move(decoded.value());
+		}
 		auto buffer = getData<T>();
 		if (buffer.size() > 0)
 		{
@@ -68,15 +100,19 @@ struct ImageChannel
 	std::vector<T> getData()
 	{
 		PROFILE_FUNCTION();
-		if (!m_Data)
+		if (auto decoded = decodeLazy<T>(true))
 		{
-			PSAPI_LOG_WARNING("ImageChannel", "Channel data does not exist yet, was it initialized?");
-			return std::vector<T>();
+			return std::move(decoded.value());
 		}
 		if (m_wasFreed)
 		{
 			PSAPI_LOG_ERROR("ImageChannel", "Data was already freed, cannot extract it anymore");
 		}
+		if (!m_Data)
+		{
+			PSAPI_LOG_WARNING("ImageChannel", "Channel data does not exist yet, was it initialized?");
+			return std::vector<T>();
+		}
 
 		std::vector<T> buffer(m_OrigByteSize / sizeof(T), 0);
 
@@ -99,13 +135,135 @@ struct ImageChannel
 	}
 
 
+	/// Copy only the given region of the image data out of the ImageChannel. Lazily read channels decode the region 
+	/// straight from the file (only reading the rows it covers where the compression allows for it) and stay lazy,
+	/// otherwise only the rows of the region are decompressed from our in-memory representation. Returns an empty 
+	/// vector if the data does not exist yet. If the data was already freed we throw
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	std::vector<T> getRegion(const ChannelRegion region)
+	{
+		std::vector<T> buffer(static_cast<uint64_t>(region.width) * region.height);
+		if (!getRegion<T>(region, buffer))
+		{
+			return std::vector<T>();
+		}
+		return buffer;
+	}
+
+
+	/// Decode the given region of the image data into the buffer which must hold at least region.width * region.height 
+	/// elements, see getRegion() above. Returns false if the data does not exist yet. If the data was already freed we throw
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	bool getRegion(const ChannelRegion region, std::span<T> buffer)
+	{
+		PROFILE_FUNCTION();
+		if (!region.fitsWithin(m_Width, m_Height))
+		{
+			PSAPI_LOG_ERROR("ImageChannel", "Region of %" PRIu32 "x%" PRIu32 " at (%" PRIu32 ", %" PRIu32 ") does not fit within the channel of size %" PRIi32 "x%" PRIi32,
+				region.width, region.height, region.x, region.y, m_Width, m_Height);
+		}
+		if (static_cast<uint64_t>(m_Width) * m_Height * sizeof(T) != m_OrigByteSize) [[unlikely]]
+		{
+			PSAPI_LOG_ERROR("ImageChannel", "Channel of %" PRIu64 " bytes cannot be accessed with a type of size %zu", m_OrigByteSize, sizeof(T));
+		}
+		const uint64_t regionSize = static_cast<uint64_t>(region.width) * region.height;
+		if (buffer.size() < regionSize)
+		{
+			PSAPI_LOG_ERROR("ImageChannel", "Provided buffer is not large enough. Expected at least: %" PRIu64 " but got %zu instead", regionSize, buffer.size());
+		}
+		if (m_IsLazy)
+		{
+			// Copy the decoder out so concurrent regions can be decoded without holding the lock
+			RegionDecoder regionDecoder;
+			{
+				std::lock_guard<std::mutex> guard(m_DecodeMutex);
+				if (m_IsLazy)
+				{
+					regionDecoder = m_RegionDecoder;
+				}
+			}
+			if (regionDecoder)
+			{
+				regionDecoder(std::span<uint8_t>(reinterpret_cast<uint8_t*>(buffer.data()), regionSize * sizeof(T)), region);
+				return true;
+			}
+			// Without a region decoder the channel is decoded once in full
+			decodeLazy<T>(true);
+		}
+		if (m_wasFreed)
+		{
+			PSAPI_LOG_ERROR("ImageChannel", "Data was already freed, cannot extract it anymore");
+		}
+		if (!m_Data)
+		{
+			PSAPI_LOG_WARNING("ImageChannel", "Channel data does not exist yet, was it initialized?");
+			return false;
+		}
+		if (regionSize == 0)
+		{
+			return true;
+		}
+
+		// blosc2 only decompresses the blocks holding the rows we ask for, full width regions are decompressed in-place
+		const uint64_t rowStart = static_cast<uint64_t>(region.y) * m_Width;
+		const uint64_t rowEnd = rowStart + static_cast<uint64_t>(region.height) * m_Width;
+		const bool fullWidth = region.x == 0 && region.width == static_cast<uint32_t>(m_Width);
+		std::vector<T> rows(fullWidth ? 0u : rowEnd - rowStart);
+		void* rowsPtr = fullWidth ? reinterpret_cast<void*>(buffer.data()) : reinterpret_cast<void*>(rows.data());
+		if (blosc2_schunk_get_slice_buffer(m_Data, rowStart, rowEnd, rowsPtr) < 0)
+		{
+			PSAPI_LOG_ERROR("ImageChannel", "Unable to decompress rows %" PRIu32 " to %" PRIu32 " of the channel", region.y, region.y + region.height);
+		}
+		if (!fullWidth)
+		{
+			for (uint64_t y = 0; y < region.height; ++y)
+			{
+				std::memcpy(buffer.data() + y * region.width, rows.data() + y * m_Width + region.x, static_cast<uint64_t>(region.width) * sizeof(T));
+			}
+		}
+		return true;
+	}
+
+
+	/// Iterate the channel in bands of full rows which are decoded one at a time into a scratch buffer of at most 
+	/// scratchSize bytes (or a single row if that is larger), allowing arbitrarily large channels to be processed in
+	/// constant memory. RLE and raw channels which were read lazily are decoded straight from the file band by band.
+	/// Lazily read zip channels are decoded in full once first as their data can only be inflated as a whole.
+	///
+	/// The returned range must outlive the iteration and the band data is only valid until the iterator is advanced
+	///
+	/// \code{.cpp}
+	/// for (const auto& band : channel.bands<bpp32_t>())
+	/// {
+	///     // band.data holds band.height rows starting at row band.y
+	/// }
+	/// \endcode
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	ChannelBands<T> bands(const uint64_t scratchSize = m_BandScratchSize)
+	{
+		if (m_IsLazy && (m_Compression == Enum::Compression::Zip || m_Compression == Enum::Compression::ZipPrediction))
+		{
+			decodeLazy<T>(true);
+		}
+		return ChannelBands<T>(*this, scratchSize);
+	}
+
+
 	/// Extract n amount of randomly selected chunks from the ImageChannel super chunk. This does not invalidate any data
 	/// and is useful to e.g. compress these chunks using photoshops compression methods to estimate the final size on disk
 	// ---------------------------------------------------------------------------------------------------------------------
 	// ---------------------------------------------------------------------------------------------------------------------
 	template <typename T>
-	std::vector<std::vector<T>> getRandomChunks(const FileHeader header, uint16_t numChunks) const
+	std::vector<std::vector<T>> getRandomChunks(const FileHeader header, uint16_t numChunks)
 	{
+		// The chunks only exist once the channel was decoded
+		decodeLazy<T>(true);
 		std::random_device rd;
 		std::mt19937 randomEngine(rd());
 		// We dont really want to deal with partial chunks so we simply ignore the last chunk.
@@ -178,6 +336,55 @@ struct ImageChannel
 	}
 
 
+	/// Construct a channel which is decoded lazily through the given decoder on first access. The decoder is called 
+	/// at most once and released afterwards
+	/// 
+	/// \param typeSize the size of a single pixel in bytes, i.e. sizeof(T) of the data the channel will be accessed as
+	/// \param regionDecoder optionally decodes parts of the channel for getRegion() without decoding the whole channel
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	ImageChannel(Enum::Compression compression, LazyDecoder decoder, const Enum::ChannelIDInfo channelID, const int32_t width, const int32_t height, const float xcoord, const float ycoord, const uint64_t typeSize, RegionDecoder regionDecoder = nullptr)
+	{
+		if (width > 300000u)
+			PSAPI_LOG_ERROR("ImageChannel", "Invalid width parsed to image channel. Photoshop channels can be 300,000 pixels wide, got %" PRIu32 " instead",
+				width);
+		if (height > 300000u)
+			PSAPI_LOG_ERROR("ImageChannel", "Invalid height parsed to image channel. Photoshop channels can be 300,000 pixels high, got %" PRIu32 " instead",
+				height);
+		if (!decoder)
+			PSAPI_LOG_ERROR("ImageChannel", "A valid decoder must be provided for lazily decoded channels");
+		m_Compression = compression;
+		m_Width = width;
+		m_Height = height;
+		m_XCoord = xcoord;
+		m_YCoord = ycoord;
+		m_ChannelID = channelID;
+		m_OrigByteSize = static_cast<uint64_t>(width) * height * typeSize;
+		m_NumChunks = (m_OrigByteSize + m_ChunkSize - 1) / m_ChunkSize;
+		m_Decoder = std::move(decoder);
+		m_RegionDecoder = std::move(regionDecoder);
+		m_IsLazy = true;
+	}
+
+
+	/// Construct a channel which only describes its extents, size and compression but holds no image data, e.g. 
+	/// when reading a document's metadata only. Accessing the data of such a channel returns an empty vector
+	/// 
+	/// \param typeSize the size of a single pixel in bytes, i.e. sizeof(T) of the data the channel describes
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	ImageChannel(Enum::Compression compression, const Enum::ChannelIDInfo channelID, const int32_t width, const int32_t height, const float xcoord, const float ycoord, const uint64_t typeSize)
+	{
+		m_Compression = compression;
+		m_Width = width;
+		m_Height = height;
+		m_XCoord = xcoord;
+		m_YCoord = ycoord;
+		m_ChannelID = channelID;
+		m_OrigByteSize = static_cast<uint64_t>(width) * height * typeSize;
+	}
+
+
 	/// Get the width of the uncompressed ImageChannel
 	int32_t getWidth() const { return m_Width; };
 	/// Get the height of the uncompressed ImageChannel
@@ -188,11 +395,15 @@ struct ImageChannel
 	float getCenterY() const { return m_YCoord; };
 	/// Get the total number of chunks held in the ImageChannel
 	uint64_t getNumChunks() const { return m_NumChunks; };
+	/// Whether the channel is lazily decoded and was not accessed yet
+	bool isLazy() const noexcept { return m_IsLazy; };
+	/// Whether the channel holds (or can decode) image data, this is false for channels which only describe their metadata
+	bool hasImageData() const noexcept { return m_IsLazy || (m_Data && !m_wasFreed); };
 
 	// On destruction free the blosc2 schunk if it wasnt freed yet
 	~ImageChannel() 
 	{
-		if (!m_wasFreed)
+		if (!m_wasFreed && m_Data)
 			blosc2_schunk_free(m_Data);
 		m_wasFreed = true;
 	}
@@ -209,6 +420,48 @@ private:
 	float m_XCoord = 0.0f;
 	float m_YCoord = 0.0f;
 
+	/// Decodes the channel on first access if it was constructed lazily, released once it was called
+	LazyDecoder m_Decoder;
+	RegionDecoder m_RegionDecoder;
+	std::atomic<bool> m_IsLazy = false;
+	std::mutex m_DecodeMutex;
+
+	// If the channel is still waiting to be decoded, decode it and return the data. If storeDecoded is true
+	// the data is additionally compressed into our blosc2 superchunk so later accesses go through the regular path.
+	// Returns nothing if the channel is not (or no longer) lazy
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	std::optional<std::vector<T>> decodeLazy(const bool storeDecoded)
+	{
+		if (!m_IsLazy)
+		{
+			return std::nullopt;
+		}
+		std::lock_guard<std::mutex> guard(m_DecodeMutex);
+		// Another thread may have decoded the channel while we were waiting
+		if (!m_IsLazy)
+		{
+			return std::nullopt;
+		}
+		PROFILE_FUNCTION();
+		if (m_OrigByteSize % sizeof(T) != 0) [[unlikely]]
+		{
+			PSAPI_LOG_ERROR("ImageChannel", "Lazily decoded channel of %" PRIu64 " bytes cannot be accessed with a type of size %zu", m_OrigByteSize, sizeof(T));
+		}
+		std::vector<T> buffer(m_OrigByteSize / sizeof(T));
+		m_Decoder(std::span<uint8_t>(reinterpret_cast<uint8_t*>(buffer.data()), m_OrigByteSize));
+		if (storeDecoded)
+		{
+			initializeBlosc2Schunk<T>(buffer, m_Width, m_Height);
+		}
+		// Releasing the decoder also releases its hold on the source
+		m_Decoder = nullptr;
+		m_RegionDecoder = nullptr;
+		m_IsLazy = false;
+		return buffer;
+	}
+
 	// Initialize a blosc2 superchunk from a given data span, maybe we could augment this to give control over compression params?
 	// ---------------------------------------------------------------------------------------------------------------------
 	// ---------------------------------------------------------------------------------------------------------------------
@@ -274,4 +527,86 @@ private:
 };
 
 
+/// A band of consecutive full rows of an ImageChannel as yielded when iterating ImageChannel::bands()
+template <typename T>
+struct ChannelBand
+{
+	/// The first row of the band within the channel
+	uint32_t y = 0u;
+	/// The number of rows in the band, only the last band may hold fewer rows than the others
+	uint32_t height = 0u;
+	/// The pixels of the band in scanline order, only valid until the iterator is advanced
+	std::span<const T> data;
+};
+
+
+/// Single-pass range over the bands of an ImageChannel, decoding one band at a time into a fixed scratch buffer.
+/// Obtained through ImageChannel::bands(), the channel must outlive the range
+template <typename T>
+struct ChannelBands
+{
+	struct Iterator
+	{
+		using iterator_category = std::input_iterator_tag;
+		using value_type = ChannelBand<T>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const ChannelBand<T>*;
+		using reference = const ChannelBand<T>&;
+
+		reference operator*() const { return m_Bands->m_Band; };
+		pointer operator->() const { return &m_Bands->m_Band; };
+		Iterator& operator++() { m_Bands->decodeBand(m_Bands->m_Band.y + m_Bands->m_Band.height); return *this; };
+		void operator++(int) { ++*this; };
+		bool operator==(std::default_sentinel_t) const { return m_Bands->m_Band.height == 0u; };
+
+		ChannelBands* m_Bands = nullptr;
+	};
+
+	/// Decodes the first band, the channel is iterated from the top
+	Iterator begin() { decodeBand(0u); return Iterator{ this }; };
+	std::default_sentinel_t end() const { return std::default_sentinel; };
+
+	/// The number of rows held by every band except for the last
+	uint32_t bandHeight() const noexcept { return m_BandHeight; };
+
+	ChannelBands(ImageChannel& channel, const uint64_t scratchSize) : m_Channel(channel)
+	{
+		const uint64_t rowSize = static_cast<uint64_t>(channel.getWidth()) * sizeof(T);
+		if (rowSize > 0)
+		{
+			m_BandHeight = static_cast<uint32_t>(std::clamp<uint64_t>(scratchSize / rowSize, 1u, std::max(channel.getHeight(), 1)));
+		}
+		m_Scratch.resize(static_cast<uint64_t>(m_BandHeight) * channel.getWidth());
+	}
+	// The iterators point back into the range so it may not be copied or moved
+	ChannelBands(const ChannelBands&) = delete;
+	ChannelBands& operator=(const ChannelBands&) = delete;
+
+private:
+	ImageChannel& m_Channel;
+	uint32_t m_BandHeight = 0u;
+	std::vector<T> m_Scratch;
+	ChannelBand<T> m_Band;
+
+	// Decode the band starting at row y into the scratch buffer, an empty band marks the end of the iteration
+	void decodeBand(const uint32_t y)
+	{
+		m_Band = ChannelBand<T>{ y, 0u, {} };
+		const uint32_t height = static_cast<uint32_t>(m_Channel.getHeight());
+		if (m_BandHeight == 0u || y >= height)
+		{
+			return;
+		}
+		const uint32_t bandHeight = std::min(m_BandHeight, height - y);
+		const ChannelRegion region(0u, y, static_cast<uint32_t>(m_Channel.getWidth()), bandHeight);
+		if (!m_Channel.getRegion<T>(region, m_Scratch))
+		{
+			return;
+		}
+		m_Band.height = bandHeight;
+		m_Band.data = std::span<const T>(m_Scratch.data(), static_cast<uint64_t>(region.width) * bandHeight);
+	}
+};
+
+
 PSAPI_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "LayerFilter.h"
+
+#include "Macros.h"
+
+#include <algorithm>
+
+PSAPI_NAMESPACE_BEGIN
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+bool LayerFilter::matchesLayer(const LayerRecord& layerRecord, const std::string& layerPath) const
+{
+	if (!m_Paths.empty())
+	{
+		const bool matchesPath = std::any_of(m_Paths.begin(), m_Paths.end(), [&](const std::string& pattern) { return matchesGlob(pattern, layerPath); });
+		if (!matchesPath)
+		{
+			return false;
+		}
+	}
+	return !m_Predicate || m_Predicate(layerRecord, layerPath);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+bool LayerFilter::matchesChannel(const Enum::ChannelIDInfo& channel) const
+{
+	return m_Channels.empty() || std::find(m_Channels.begin(), m_Channels.end(), channel) != m_Channels.end();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+bool LayerFilter::matchesGlob(std::string_view pattern, std::string_view path)
+{
+	while (!pattern.empty())
+	{
+		if (pattern.starts_with("**"))
+		{
+			pattern.remove_prefix(2);
+			for (size_t i = 0; i <= path.size(); ++i)
+			{
+				if (matchesGlob(pattern, path.substr(i)))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+		if (pattern.front() == '*')
+		{
+			// A single wildcard may not cross into the next path segment
+			pattern.remove_prefix(1);
+			for (size_t i = 0; i <= path.size(); ++i)
+			{
+				if (matchesGlob(pattern, path.substr(i)))
+				{
+					return true;
+				}
+				if (i < path.size() && path[i] == '/')
+				{
+					return false;
+				}
+			}
+			return false;
+		}
+		if (path.empty())
+		{
+			return false;
+		}
+		const bool matchesCharacter = pattern.front() == '?' ? path.front() != '/' : pattern.front() == path.front();
+		if (!matchesCharacter)
+		{
+			return false;
+		}
+		pattern.remove_prefix(1);
+		path.remove_prefix(1);
+	}
+	return path.empty();
+}
+
+
+PSAPI_NAMESPACE_END
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Macros.h"
+#include "Enum.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+struct LayerRecord;
+
+
+/// Restricts which layers and channels of a document get their image data decoded on read. Layers (and channels)
+/// which do not match are still part of the document so the layer hierarchy stays intact but only hold their
+/// metadata, i.e. they report their extents and compression but no image data.
+///
+/// A layer is decoded if its path matches any of the patterns (or no patterns are given) and the predicate
+/// (if any) returns true for it. Paths are built from the group names separated by '/' the same way as for
+/// LayeredFile::findLayer(), e.g. "Group/Nested Group/Layer". Within the patterns '*' matches any sequence of
+/// characters within a path segment, '**' matches across segments and '?' matches any single character
+struct LayerFilter
+{
+	using Predicate = std::function<bool(const LayerRecord& layerRecord, const std::string& layerPath)>;
+
+	/// Glob patterns matched against the full path of the layer
+	std::vector<std::string> m_Paths;
+	/// Additional predicate over the layer record (name, flags etc.) as well as its path
+	Predicate m_Predicate;
+	/// The channels to decode of the matching layers, all channels are decoded if this is empty
+	std::vector<Enum::ChannelIDInfo> m_Channels;
+
+	/// Whether the image data of the given layer should be decoded
+	bool matchesLayer(const LayerRecord& layerRecord, const std::string& layerPath) const;
+
+	/// Whether the image data of the given channel should be decoded, only applies to layers which matched
+	bool matchesChannel(const Enum::ChannelIDInfo& channel) const;
+
+	/// Match the path against the glob pattern
+	static bool matchesGlob(std::string_view pattern, std::string_view path);
+};
+
+
+PSAPI_NAMESPACE_END
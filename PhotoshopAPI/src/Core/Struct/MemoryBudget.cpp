@@ -0,0 +1,113 @@
+#include "MemoryBudget.h"
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <utility>
+
+PSAPI_NAMESPACE_BEGIN
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryBudget::Reservation::Reservation(Reservation&& other) noexcept
+	: m_Budget(std::exchange(other.m_Budget, nullptr)), m_Size(std::exchange(other.m_Size, 0u))
+{
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryBudget::Reservation& MemoryBudget::Reservation::operator=(Reservation&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		m_Budget = std::exchange(other.m_Budget, nullptr);
+		m_Size = std::exchange(other.m_Size, 0u);
+	}
+	return *this;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryBudget::Reservation::~Reservation()
+{
+	release();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MemoryBudget::Reservation::release() noexcept
+{
+	if (m_Budget)
+	{
+		m_Budget->release(m_Size);
+	}
+	m_Budget = nullptr;
+	m_Size = 0u;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryBudget::MemoryBudget(const uint64_t limit) : m_Limit(limit)
+{
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+MemoryBudget::Reservation MemoryBudget::reserve(const uint64_t size)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	// An oversized reservation would never fit next to others so we let it through once it is the only one
+	m_Released.wait(lock, [&]() { return m_InUse == 0u || m_InUse + size <= m_Limit; });
+	m_InUse += size;
+	m_HighWaterMark = std::max(m_HighWaterMark, m_InUse);
+	return Reservation(this, size);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+uint64_t MemoryBudget::inUse() const noexcept
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_InUse;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+uint64_t MemoryBudget::highWaterMark() const noexcept
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_HighWaterMark;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MemoryBudget::resetHighWaterMark() noexcept
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_HighWaterMark = m_InUse;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void MemoryBudget::release(const uint64_t size) noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_InUse -= std::min(size, m_InUse);
+	}
+	m_Released.notify_all();
+}
+
+
+PSAPI_NAMESPACE_END
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+/// A byte budget which bounds the memory held by concurrently running decode tasks. Before a task starts it reserves
+/// the memory it is known to need (its compressed data as well as its decoded buffers) and waits until that fits
+/// within the limit next to all the other reservations. This keeps the peak memory of decoding bounded by the budget
+/// rather than by the number of cores.
+///
+/// A single budget may be shared between many documents read at the same time (e.g. by multiple worker threads) to
+/// bound their combined memory. Reservations larger than the whole budget are admitted once no other reservation is
+/// held so that they run on their own rather than stalling forever. Only reservations ever block, so a thread must
+/// not wait for a reservation while holding another one of the same budget.
+struct MemoryBudget
+{
+	/// A reservation of bytes on a budget which is released on destruction
+	struct Reservation
+	{
+		Reservation() = default;
+		Reservation(MemoryBudget* budget, const uint64_t size) : m_Budget(budget), m_Size(size) {};
+		Reservation(const Reservation&) = delete;
+		Reservation& operator=(const Reservation&) = delete;
+		Reservation(Reservation&& other) noexcept;
+		Reservation& operator=(Reservation&& other) noexcept;
+		~Reservation();
+
+		inline uint64_t size() const noexcept { return m_Size; }
+
+		/// Release the reserved bytes ahead of destruction
+		void release() noexcept;
+
+	private:
+		MemoryBudget* m_Budget = nullptr;
+		uint64_t m_Size = 0u;
+	};
+
+	/// Initialize the budget with the maximum amount of bytes which may be reserved at once
+	explicit MemoryBudget(const uint64_t limit);
+	MemoryBudget(const MemoryBudget&) = delete;
+	MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+	/// Block until the given amount of bytes fits within the budget and reserve them
+	Reservation reserve(const uint64_t size);
+
+	/// The maximum amount of bytes which may be reserved at once
+	inline uint64_t limit() const noexcept { return m_Limit; }
+
+	/// The amount of bytes currently reserved
+	uint64_t inUse() const noexcept;
+
+	/// The largest amount of bytes reserved at once since construction or the last call to resetHighWaterMark()
+	uint64_t highWaterMark() const noexcept;
+
+	/// Reset the high-water mark to the amount of bytes currently reserved
+	void resetHighWaterMark() noexcept;
+
+private:
+	uint64_t m_Limit = 0u;
+	uint64_t m_InUse = 0u;
+	uint64_t m_HighWaterMark = 0u;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Released;
+
+	/// Return the given amount of bytes to the budget and wake up any waiting reservations
+	void release(const uint64_t size) noexcept;
+};
+
+
+PSAPI_NAMESPACE_END
@@ -161,4 +161,110 @@ void ICCProfileBlock::write(File& document)
 	WritePadddingBytes(document, m_DataSize - m_RawICCProfile.size());
 }
 
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+ThumbnailBlock::ThumbnailBlock(Enum::ThumbnailFormat format, uint32_t width, uint32_t height, std::vector<uint8_t>&& data)
+{
+	m_UniqueId = Enum::ImageResource::ThumbnailResource;
+	m_Name = { "", 2u };
+	m_DataSize = RoundUpToMultiple<uint32_t>(28u + data.size(), 2u);	// 28 bytes of thumbnail header followed by the data
+	m_Size = ResourceBlock::calculateSize();
+
+	m_Format = format;
+	m_Width = width;
+	m_Height = height;
+	m_WidthBytes = RoundUpToMultiple<uint32_t>(width * m_BitsPerPixel * m_NumPlanes, 32u) / 8u;
+	if (m_Format == Enum::ThumbnailFormat::RawRGB && data.size() != static_cast<uint64_t>(m_WidthBytes) * m_Height)
+	{
+		PSAPI_LOG_ERROR("ThumbnailBlock", "Raw thumbnails must hold rows of %u bytes for a total of %u bytes, got %zu bytes instead", 
+			m_WidthBytes, m_WidthBytes * m_Height, data.size());
+	}
+	m_Data = std::move(data);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+bool ThumbnailBlock::read(File& document, const uint64_t offset)
+{
+	PROFILE_FUNCTION();
+	m_Offset = offset;
+	m_UniqueId = Enum::ImageResource::ThumbnailResource;
+	m_Name.read(document, 2u);
+	m_DataSize = RoundUpToMultiple(ReadBinaryData<uint32_t>(document), 2u);
+	m_Size = static_cast<uint64_t>(4u) + 2u + m_Name.m_Size + 4u + m_DataSize;
+
+	// A malformed thumbnail should not stop us from reading the rest of the document so we skip the block instead
+	if (m_DataSize < 28u) [[unlikely]]
+	{
+		PSAPI_LOG_WARNING("ThumbnailBlock", "Data size must be at least 28, not %u. Skipping the thumbnail", m_DataSize);
+		document.skip(m_DataSize);
+		return false;
+	}
+
+	const uint32_t format = ReadBinaryData<uint32_t>(document);
+	if (!Enum::thumbnailFormatMap.contains(format)) [[unlikely]]
+	{
+		PSAPI_LOG_WARNING("ThumbnailBlock", "Unknown thumbnail format %u. Skipping the thumbnail", format);
+		document.skip(m_DataSize - 4u);
+		return false;
+	}
+	m_Format = Enum::thumbnailFormatMap.at(format);
+	m_Width = ReadBinaryData<uint32_t>(document);
+	m_Height = ReadBinaryData<uint32_t>(document);
+	m_WidthBytes = ReadBinaryData<uint32_t>(document);
+	const uint32_t totalSize = ReadBinaryData<uint32_t>(document);
+	const uint32_t compressedSize = ReadBinaryData<uint32_t>(document);
+	m_BitsPerPixel = ReadBinaryData<uint16_t>(document);
+	m_NumPlanes = ReadBinaryData<uint16_t>(document);
+
+	// Raw thumbnails are stored uncompressed so their size is the total size of the decoded thumbnail
+	const uint32_t dataSize = m_Format == Enum::ThumbnailFormat::JpegRGB ? compressedSize : totalSize;
+	if (dataSize > m_DataSize - 28u) [[unlikely]]
+	{
+		PSAPI_LOG_WARNING("ThumbnailBlock", "Thumbnail data of %u bytes does not fit into the block of %u bytes. Skipping the thumbnail", dataSize, m_DataSize);
+		document.skip(m_DataSize - 28u);
+		return false;
+	}
+	m_Data = ReadBinaryArray<uint8_t>(document, dataSize);
+	document.skip(m_DataSize - 28u - dataSize);
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ThumbnailBlock::write(File& document)
+{
+	PROFILE_FUNCTION();
+
+	Signature sig = Signature("8BIM");
+	WriteBinaryData<uint32_t>(document, sig.m_Value);
+
+	WriteBinaryData<uint16_t>(document, Enum::imageResourceToInt(m_UniqueId));
+	m_Name.write(document, 2u);
+	WriteBinaryData<uint32_t>(document, m_DataSize);	// This value is already padded
+
+	// Check that we didnt initialize m_DataSize incorrectly
+	if (m_DataSize < 28u + m_Data.size()) [[unlikely]]
+	{
+		PSAPI_LOG_ERROR("ThumbnailBlock", "Block of %u bytes cannot hold %zu bytes of thumbnail data, is m_DataSize initialized correctly?", m_DataSize, m_Data.size());
+	}
+
+	WriteBinaryData<uint32_t>(document, Enum::thumbnailFormatMapRev.at(m_Format));
+	WriteBinaryData<uint32_t>(document, m_Width);
+	WriteBinaryData<uint32_t>(document, m_Height);
+	WriteBinaryData<uint32_t>(document, m_WidthBytes);
+	WriteBinaryData<uint32_t>(document, m_WidthBytes * m_Height);
+	WriteBinaryData<uint32_t>(document, static_cast<uint32_t>(m_Data.size()));
+	WriteBinaryData<uint16_t>(document, m_BitsPerPixel);
+	WriteBinaryData<uint16_t>(document, m_NumPlanes);
+
+	// Single bytes need no endian conversion so we write the data directly rather than giving it up
+	document.write(std::span<uint8_t>(m_Data));
+	// This will handle the 0 byte case
+	WritePadddingBytes(document, m_DataSize - 28u - m_Data.size());
+}
+
 PSAPI_NAMESPACE_END
\ No newline at end of file
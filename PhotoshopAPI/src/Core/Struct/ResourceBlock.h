@@ -82,4 +82,32 @@ struct ICCProfileBlock : public ResourceBlock
 	void write(File& document) override;
 };
 
+
+/// This ResourceBlock holds the preview thumbnail Photoshop embeds into the document, usually as a JPEG file 
+/// of at most 160x160 pixels. The encoded bytes are stored as-is so they can be handed to any image decoder
+struct ThumbnailBlock : public ResourceBlock
+{
+	/// Whether m_Data holds a JPEG file or raw interleaved RGB pixels
+	Enum::ThumbnailFormat m_Format = Enum::ThumbnailFormat::JpegRGB;
+	uint32_t m_Width = 0u;
+	uint32_t m_Height = 0u;
+	/// The size of a single row of the decoded thumbnail padded to 4 bytes
+	uint32_t m_WidthBytes = 0u;
+	uint16_t m_BitsPerPixel = 24u;
+	uint16_t m_NumPlanes = 1u;
+	/// The encoded thumbnail, for JPEG thumbnails this is a complete JFIF file
+	std::vector<uint8_t> m_Data;
+
+	// We dont overwrite calculateSize here since we read m_DataSize which gives us all the info to know the size
+
+	ThumbnailBlock() = default;
+	ThumbnailBlock(Enum::ThumbnailFormat format, uint32_t width, uint32_t height, std::vector<uint8_t>&& data);
+
+	/// Read the block, a malformed thumbnail is skipped with a warning
+	///
+	/// \return false if the thumbnail was malformed, the document is then positioned past the block regardless
+	bool read(File& document, const uint64_t offset);
+	void write(File& document) override;
+};
+
 PSAPI_NAMESPACE_END
\ No newline at end of file
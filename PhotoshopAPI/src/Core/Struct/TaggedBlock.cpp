@@ -24,6 +24,8 @@ void TaggedBlock::read(File& document, const FileHeader& header, const uint64_t
 		uint64_t length = ReadBinaryData<uint64_t>(document);
 		length = RoundUpToMultiple<uint64_t>(length, padding);
 		m_Length = length;
+		// Unparsed blocks such as embedded smart objects ('lnk2', 'lnk3' or 'lnkE') can be hundreds of megabytes,
+		// skipping only moves the offset marker so we never touch that data
 		document.skip(length);
 
 		m_TotalLength = length + 4u + 4u + 8u;
@@ -416,6 +416,57 @@ public:
 		return std::vector<T>();
 	}
 
+	/// Copy a rectangular region of the specified channel without decoding the rest of it. This also works for masks.
+	/// For lazily read layers the region is decoded straight from the file, see ImageChannel::getRegion()
+	///
+	/// \param channelID the channel ID to extract the region from
+	/// \param region the region relative to the top left of the channel, must lie within the channel
+	std::vector<T> getChannelRegion(const Enum::ChannelID channelID, const ChannelRegion region)
+	{
+		if (channelID == Enum::ChannelID::UserSuppliedLayerMask)
+		{
+			if (this->m_LayerMask.has_value())
+			{
+				return this->m_LayerMask.value().maskData->template getRegion<T>(region);
+			}
+			PSAPI_LOG_WARNING("ImageLayer", "Layer doesnt have a mask channel, returning an empty vector");
+			return std::vector<T>();
+		}
+		for (auto& [key, value] : m_ImageData)
+		{
+			if (key.id == channelID)
+			{
+				return value->template getRegion<T>(region);
+			}
+		}
+		PSAPI_LOG_WARNING("ImageLayer", "Unable to find channel in ImageData, returning an empty vector");
+		return std::vector<T>();
+	}
+
+	/// Get the hash of the compressed data the specified channel was read from without decoding it. This also works
+	/// for masks. Returns std::nullopt for channels which were not read eagerly from a file, see ImageChannel::m_CompressedHash
+	///
+	/// \param channelID the channel ID to get the hash of
+	std::optional<uint64_t> getChannelHash(const Enum::ChannelID channelID) const
+	{
+		if (channelID == Enum::ChannelID::UserSuppliedLayerMask)
+		{
+			if (this->m_LayerMask.has_value())
+			{
+				return this->m_LayerMask.value().maskData->m_CompressedHash;
+			}
+			return std::nullopt;
+		}
+		for (const auto& [key, value] : m_ImageData)
+		{
+			if (key.id == channelID)
+			{
+				return value->m_CompressedHash;
+			}
+		}
+		return std::nullopt;
+	}
+
 	/// Extract all the channels of the ImageLayer into an unordered_map. Includes the mask channel
 	/// 
 	/// \param doCopy whether to extract the image data by copying the data. If this is false the channel will no longer hold any image data!
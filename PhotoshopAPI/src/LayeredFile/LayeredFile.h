@@ -886,6 +886,81 @@ struct LayeredFile
 		return LayeredFile<T>::read(filePath, callback);
 	}
 
+	/// \brief read and create a LayeredFile from disk with the given file parameters
+	///
+	/// This e.g. allows reading the layers lazily, only decoding the image data of the channels which are
+	/// actually accessed:
+	/// 
+	/// \code{.cpp}
+	/// File::FileParams params;
+	/// params.lazyChannels = true;
+	/// ProgressCallback callback{};
+	/// auto layeredFile = LayeredFile<bpp8_t>::read(filePath, params, callback);
+	/// \endcode
+	/// 
+	/// \param filePath the path on disk of the file to be read
+	/// \param params the parameters to open the file with, doRead is always treated as true
+	/// \param callback the callback which reports back the current progress and task to the user
+	static LayeredFile<T> read(const std::filesystem::path& filePath, File::FileParams params, ProgressCallback& callback)
+	{
+		params.doRead = true;
+		auto inputFile = File(filePath, params);
+		return LayeredFile<T>::read(inputFile, callback);
+	}
+
+	/// \brief read and create a LayeredFile from disk, only decoding the image data of the layers and channels matching the filter
+	///
+	/// All other layers are still part of the hierarchy but only hold their metadata. E.g. to only decode the 
+	/// masks of the visible layers in a group:
+	/// 
+	/// \code{.cpp}
+	/// LayerFilter filter;
+	/// filter.m_Paths = { "Group/*" };
+	/// filter.m_Predicate = [](const LayerRecord& record, const std::string& path) { return !record.m_BitFlags.m_isHidden; };
+	/// filter.m_Channels = { Enum::ChannelIDInfo{ Enum::ChannelID::UserSuppliedLayerMask, -2 } };
+	/// ProgressCallback callback{};
+	/// auto layeredFile = LayeredFile<bpp8_t>::read(filePath, filter, callback);
+	/// \endcode
+	/// 
+	/// \param filePath the path on disk of the file to be read
+	/// \param filter the filter selecting the layers and channels to decode
+	/// \param callback the callback which reports back the current progress and task to the user
+	static LayeredFile<T> read(const std::filesystem::path& filePath, LayerFilter filter, ProgressCallback& callback)
+	{
+		File::FileParams params;
+		params.layerFilter = std::move(filter);
+		return LayeredFile<T>::read(filePath, params, callback);
+	}
+
+	/// \brief read and create a LayeredFile from an already constructed File
+	///
+	/// This allows reading from any ByteSource rather than just from disk, e.g. from a 
+	/// buffer in memory without having to go through a temporary file:
+	/// 
+	/// \code{.cpp}
+	/// File document(std::make_unique<MemoryByteSource>(std::move(bytes)));
+	/// auto layeredFile = LayeredFile<bpp8_t>::read(document);
+	/// \endcode
+	/// 
+	/// \param document the file to read from, must have been opened for reading
+	/// \param callback the callback which reports back the current progress and task to the user
+	static LayeredFile<T> read(File& document, ProgressCallback& callback)
+	{
+		auto psDocumentPtr = std::make_unique<PhotoshopFile>();
+		psDocumentPtr->read(document, callback);
+		LayeredFile<T> layeredFile = { std::move(psDocumentPtr) };
+		return layeredFile;
+	}
+
+	/// \brief read and create a LayeredFile from an already constructed File
+	///
+	/// \param document the file to read from, must have been opened for reading
+	static LayeredFile<T> read(File& document)
+	{
+		ProgressCallback callback{};
+		return LayeredFile<T>::read(document, callback);
+	}
+
 	/// \brief write the LayeredFile instance to disk, consumes and invalidates the instance
 	/// 
 	/// Simplify the writing of a LayeredFile by abstracting away the step of 
@@ -921,6 +996,55 @@ struct LayeredFile
 		LayeredFile<T>::write(std::move(layeredFile), filePath, callback, forceOvewrite);
 	}
 
+	/// \brief write the LayeredFile instance to an already constructed File, consumes and invalidates the instance
+	/// 
+	/// This allows writing to any ByteSink rather than just to disk, e.g. to a user-supplied buffer through a 
+	/// CallbackByteSink. As there is no file extension to deduce the version from it has to be passed explicitly.
+	/// The output is byte-identical to writing to a path with the respective extension
+	/// 
+	/// \param layeredFile The LayeredFile to consume, invalidates it
+	/// \param document The file to write to, must have been opened for writing
+	/// \param version Whether to write a PSD or PSB document
+	/// \param callback the callback which reports back the current progress and task to the user
+	static void write(LayeredFile<T>&& layeredFile, File& document, const Enum::Version version, ProgressCallback& callback)
+	{
+		auto psdOutDocumentPtr = LayeredToPhotoshopFile(std::move(layeredFile));
+		psdOutDocumentPtr->m_Header.m_Version = version;
+		psdOutDocumentPtr->write(document, callback);
+	}
+
+	/// \brief write the LayeredFile instance to an in-memory buffer, consumes and invalidates the instance
+	/// 
+	/// Nothing touches the filesystem which makes this suitable for e.g. returning generated documents from a server. 
+	/// The buffer is byte-identical to what would be written to a path with the respective extension:
+	/// 
+	/// \code{.cpp}
+	/// std::vector<uint8_t> bytes = LayeredFile<bpp8_t>::writeToMemory(std::move(layeredFile), Enum::Version::Psb);
+	/// \endcode
+	/// 
+	/// \param layeredFile The LayeredFile to consume, invalidates it
+	/// \param version Whether to write a PSD or PSB document
+	/// \param callback the callback which reports back the current progress and task to the user
+	static std::vector<uint8_t> writeToMemory(LayeredFile<T>&& layeredFile, const Enum::Version version, ProgressCallback& callback)
+	{
+		auto sink = std::make_unique<MemoryByteSink>();
+		MemoryByteSink* sinkPtr = sink.get();
+		// The File owns the sink so we have to take the data out before it goes out of scope
+		File document(std::move(sink));
+		LayeredFile<T>::write(std::move(layeredFile), document, version, callback);
+		return sinkPtr->release();
+	}
+
+	/// \brief write the LayeredFile instance to an in-memory buffer, consumes and invalidates the instance
+	/// 
+	/// \param layeredFile The LayeredFile to consume, invalidates it
+	/// \param version Whether to write a PSD or PSB document
+	static std::vector<uint8_t> writeToMemory(LayeredFile<T>&& layeredFile, const Enum::Version version = Enum::Version::Psd)
+	{
+		ProgressCallback callback{};
+		return LayeredFile<T>::writeToMemory(std::move(layeredFile), version, callback);
+	}
+
 private:
 
 	/// \brief Checks if moving the child layer to the provided parent layer is valid.
@@ -987,7 +1111,7 @@ std::unique_ptr<PhotoshopFile> LayeredToPhotoshopFile(LayeredFile<T>&& layeredFi
 	LayerAndMaskInformation lrMaskInfo = generateLayerMaskInfo<T>(layeredFile, header);
 	ImageData imageData = ImageData(layeredFile.getNumChannels(true, true));	// Ignore any mask or alpha channels
 
-	return std::make_unique<PhotoshopFile>(header, colorModeData, std::move(imageResources), std::move(lrMaskInfo), imageData);
+	return std::make_unique<PhotoshopFile>(header, colorModeData, std::move(imageResources), std::move(lrMaskInfo), std::move(imageData));
 }
 
 
@@ -118,10 +118,16 @@ void FileHeader::write(File& document)
 	// Write the signature, must be 8BPS
 	WriteBinaryData<uint32_t>(document, Signature("8BPS").m_Value);
 
-	// We automatically detect and write the version based on which extension our document has for simplicity's sake
+	// We automatically detect and write the version based on which extension our document has for simplicity's sake.
+	// Documents that are not backed by a path (e.g. in-memory sinks) instead write the version stored on the header
 	auto filePath = document.getPath();
 	auto extension = filePath.extension();
-	if (extension == ".psb")
+	if (filePath.empty())
+	{
+		std::optional<uint16_t> versionVal = findByValue(Enum::versionMap, m_Version);
+		WriteBinaryData<uint16_t>(document, versionVal.value());
+	}
+	else if (extension == ".psb")
 	{
 		m_Version = Enum::Version::Psb;
 		std::optional<uint16_t> versionVal = findByValue(Enum::versionMap, Enum::Version::Psb);
@@ -0,0 +1,225 @@
+#include "ImageData.h"
+
+#include "Macros.h"
+#include "Core/FileIO/Read.h"
+#include "Core/FileIO/Util.h"
+#include "Core/Struct/ByteStream.h"
+#include "Core/Compression/Decompress_RLE.h"
+#include "Core/Endian/EndianByteSwapArr.h"
+#include "Profiling/Perf/Instrumentor.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <vector>
+
+#include <cstring>
+
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+namespace
+{
+	// A band of scanlines of a single channel of the merged image data, this is the unit of work we decode in parallel
+	struct ChannelBand
+	{
+		uint64_t channel;
+		uint64_t rowBegin;
+		uint64_t rowEnd;
+	};
+
+
+	// Split all the channels into bands of scanlines such that a single large channel still keeps every core busy
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	std::vector<ChannelBand> generateChannelBands(const uint64_t numChannels, const uint64_t scanlineSize, const uint32_t height)
+	{
+		std::vector<ChannelBand> bands;
+		const uint32_t bandHeight = RLE_Impl::BandHeight(scanlineSize, height);
+		for (uint64_t channel = 0; channel < numChannels; ++channel)
+		{
+			for (uint64_t row = 0; row < height; row += bandHeight)
+			{
+				bands.push_back({ channel, row, std::min<uint64_t>(row + bandHeight, height) });
+			}
+		}
+		return bands;
+	}
+
+
+	// Decode the planar channels of the merged image data which follow the compression marker at offset into one
+	// buffer per channel. The scanline byte counts of RLE data are stored for all channels up front, followed by
+	// the compressed scanlines of all channels. As the section has no size marker we only ever read the exact extent
+	// of the data, which is returned through size, rather than everything up to the end of the document whose size
+	// may not be known for streamed sources
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	std::vector<std::vector<T>> decodeChannels(File& document, const FileHeader& header, const uint64_t offset, uint64_t& size, const Enum::Compression compression)
+	{
+		PROFILE_FUNCTION();
+		const uint64_t numChannels = header.m_NumChannels;
+		const uint32_t width = header.m_Width;
+		const uint32_t height = header.m_Height;
+		const uint64_t scanlineSize = static_cast<uint64_t>(width) * sizeof(T);
+		// Only used for validation, for sources of unknown size this is effectively unbounded
+		const uint64_t available = document.getSize() - offset;
+
+		std::vector<std::vector<T>> channels(numChannels);
+		for (auto& channel : channels)
+		{
+			channel.resize(static_cast<uint64_t>(width) * height);
+		}
+		const std::vector<ChannelBand> bands = generateChannelBands(numChannels, scanlineSize, height);
+
+		if (compression == Enum::Compression::Raw)
+		{
+			size = numChannels * height * scanlineSize;
+			if (size > available)
+			{
+				PSAPI_LOG_ERROR("ImageData", "Raw merged image data requires %" PRIu64 " bytes but the section only holds %" PRIu64 " bytes",
+					size, available);
+			}
+			ByteStream stream(document, offset, size);
+			std::span<const uint8_t> data = stream.read(uint64_t{ 0u }, size);
+			auto copyBand = [&](const ChannelBand& band)
+				{
+					std::span<T> buffer(channels[band.channel].data() + band.rowBegin * width, (band.rowEnd - band.rowBegin) * width);
+					std::memcpy(buffer.data(), data.data() + (band.channel * height + band.rowBegin) * scanlineSize, buffer.size_bytes());
+					endianDecodeBEArray(buffer);
+				};
+#ifdef __APPLE__
+			std::for_each(bands.begin(), bands.end(), copyBand);
+#else
+			std::for_each(std::execution::par, bands.begin(), bands.end(), copyBand);
+#endif
+			return channels;
+		}
+
+		// Turn the byte counts of the scanlines of all channels into offsets into the compressed data, as the channels
+		// are stored back to back the offsets of every channel are a window into these
+		const uint64_t byteCountsSize = numChannels * height * SwapPsdPsb<uint16_t, uint32_t>(header.m_Version);
+		if (byteCountsSize > available)
+		{
+			PSAPI_LOG_ERROR("ImageData", "The merged image data of %" PRIu64 " bytes cannot hold the scanline sizes of %" PRIu64 " channels", available, numChannels);
+		}
+		std::vector<uint64_t> compressedOffsets(numChannels * height + 1u, 0u);
+		{
+			ByteStream byteCountsStream(document, offset, byteCountsSize);
+			if (header.m_Version == Enum::Version::Psd)
+			{
+				std::vector<uint16_t> byteCounts = ReadBinaryArray<uint16_t>(byteCountsStream, 0u, byteCountsSize);
+				std::inclusive_scan(byteCounts.begin(), byteCounts.end(), compressedOffsets.begin() + 1, std::plus<uint64_t>(), uint64_t{ 0u });
+			}
+			else
+			{
+				std::vector<uint32_t> byteCounts = ReadBinaryArray<uint32_t>(byteCountsStream, 0u, byteCountsSize);
+				std::inclusive_scan(byteCounts.begin(), byteCounts.end(), compressedOffsets.begin() + 1, std::plus<uint64_t>(), uint64_t{ 0u });
+			}
+		}
+		if (compressedOffsets.back() > available - byteCountsSize)
+		{
+			PSAPI_LOG_ERROR("ImageData", "The scanline sizes of the merged image data add up to %" PRIu64 " bytes but the section only holds %" PRIu64 " bytes",
+				compressedOffsets.back(), available - byteCountsSize);
+		}
+
+		// The byte counts tell us exactly how much compressed data follows them
+		size = byteCountsSize + compressedOffsets.back();
+		ByteStream stream(document, offset + byteCountsSize, compressedOffsets.back());
+		std::span<const uint8_t> compressedData = stream.read(uint64_t{ 0u }, compressedOffsets.back());
+		auto decompressBand = [&](const ChannelBand& band)
+			{
+				std::span<const uint64_t> channelOffsets(compressedOffsets.data() + band.channel * height, static_cast<uint64_t>(height) + 1u);
+				RLE_Impl::DecompressScanlines<T>(compressedData, channelOffsets, channels[band.channel], width, band.rowBegin, band.rowEnd);
+			};
+#ifdef __APPLE__
+		std::for_each(bands.begin(), bands.end(), decompressBand);
+#else
+		std::for_each(std::execution::par, bands.begin(), bands.end(), decompressBand);
+#endif
+		return channels;
+	}
+
+
+	// Decode the merged image data and store each of its channels as an ImageChannel spanning the whole canvas
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	std::vector<std::unique_ptr<ImageChannel>> readChannels(File& document, const FileHeader& header, const uint64_t offset, uint64_t& size, const Enum::Compression compression)
+	{
+		std::vector<std::vector<T>> channels = decodeChannels<T>(document, header, offset, size, compression);
+
+		std::vector<std::unique_ptr<ImageChannel>> imageChannels(channels.size());
+		std::vector<uint64_t> indices(channels.size());
+		std::iota(indices.begin(), indices.end(), 0u);
+		// The color channels map to their regular IDs while any additional alpha or spot channels are custom channels
+		const uint64_t numColorChannels = header.m_ColorMode == Enum::ColorMode::RGB ? 3u : header.m_ColorMode == Enum::ColorMode::CMYK ? 4u :
+			header.m_ColorMode == Enum::ColorMode::Grayscale ? 1u : 0u;
+#ifdef __APPLE__
+		std::for_each(indices.begin(), indices.end(), [&](const uint64_t index)
+#else
+		std::for_each(std::execution::par, indices.begin(), indices.end(), [&](const uint64_t index)
+#endif
+			{
+				const Enum::ChannelIDInfo channelID = index < numColorChannels ?
+					Enum::intToChannelIDInfo(static_cast<int16_t>(index), header.m_ColorMode) :
+					Enum::ChannelIDInfo{ Enum::ChannelID::Custom, static_cast<int16_t>(index) };
+				imageChannels[index] = std::make_unique<ImageChannel>(compression, channels[index], channelID, header.m_Width, header.m_Height, 0.0f, 0.0f);
+				// Release the decoded data as soon as it is held compressed
+				channels[index] = std::vector<T>();
+			});
+		return imageChannels;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ImageData::read(File& document, const FileHeader& header, const uint64_t offset)
+{
+	PROFILE_FUNCTION();
+	m_Offset = offset;
+	m_ImageData.clear();
+	if (offset + 2u > document.getSize())
+	{
+		PSAPI_LOG_ERROR("ImageData", "The merged image data at offset %" PRIu64 " lies outside of the document of %" PRIu64 " bytes", offset, document.getSize());
+	}
+	// The section has no size marker, we only know its size once we read the compression marker and scanline sizes
+	m_Size = 2u;
+
+	document.setOffset(offset);
+	m_Compression = Enum::compressionMap.at(ReadBinaryData<uint16_t>(document));
+	if (m_Compression != Enum::Compression::Raw && m_Compression != Enum::Compression::Rle)
+	{
+		PSAPI_LOG_WARNING("ImageData", "Zip compressed merged image data is not supported, skipping it");
+		return;
+	}
+
+	const uint64_t dataOffset = offset + 2u;
+	uint64_t dataSize = 0u;
+	if (header.m_Depth == Enum::BitDepth::BD_8)
+	{
+		m_ImageData = readChannels<uint8_t>(document, header, dataOffset, dataSize, m_Compression);
+	}
+	else if (header.m_Depth == Enum::BitDepth::BD_16)
+	{
+		m_ImageData = readChannels<uint16_t>(document, header, dataOffset, dataSize, m_Compression);
+	}
+	else if (header.m_Depth == Enum::BitDepth::BD_32)
+	{
+		m_ImageData = readChannels<float32_t>(document, header, dataOffset, dataSize, m_Compression);
+	}
+	else
+	{
+		PSAPI_LOG_WARNING("ImageData", "Reading the merged image data of 1-bit documents is not supported, skipping it");
+	}
+	m_Size += dataSize;
+	document.setOffset(offset + m_Size);
+}
+
+
+PSAPI_NAMESPACE_END
@@ -4,11 +4,15 @@
 #include "Enum.h"
 #include "Core/Struct/File.h"
 #include "Core/Struct/Section.h"
+#include "Core/Struct/ImageChannel.h"
 #include "Core/FileIO/Write.h"
 #include "Core/Compression/Compress_RLE.h"
 
 #include "blosc2.h"
 
+#include <memory>
+#include <vector>
+
 
 PSAPI_NAMESPACE_BEGIN
 
@@ -67,9 +71,18 @@ namespace ImageDataImpl
 /// \brief This section is for interoperability with different software such as lightroom and holds a composite of all the layers
 ///
 /// When writing out data we fill it with empty pixels using Rle compression, this is due to Photoshop unfortunately requiring
-/// it to be present. Due to this compression step we can usually save lots of data over what Photoshop writes out
+/// it to be present. Due to this compression step we can usually save lots of data over what Photoshop writes out.
+///
+/// When read, the merged composite is decoded into one channel per document channel (see FileHeader::m_NumChannels) which
+/// is far cheaper than decoding and compositing the layers for e.g. previews. Note that documents saved without 
+/// 'Maximize Compatibility' only hold an empty (white) composite here.
 struct ImageData : public FileSection
 {
+	/// The compression of the merged image data as found on read
+	Enum::Compression m_Compression = Enum::Compression::Rle;
+	/// The channels of the merged composite in the order they are stored, i.e. the color channels followed by any 
+	/// alpha and spot channels. These cover the whole canvas and are only populated on read
+	std::vector<std::unique_ptr<ImageChannel>> m_ImageData;
 
 	inline uint64_t calculateSize(std::shared_ptr<FileHeader> header /* = nullptr */) const override { return 0; };
 
@@ -98,7 +111,26 @@ struct ImageData : public FileSection
 		}
 	}
 
+	/// Read the merged composite starting at the given offset (the end of the LayerAndMaskInformation section) and decode
+	/// all of its channels. Channels as well as bands of scanlines of each channel are decoded in parallel
+	void read(File& document, const FileHeader& header, const uint64_t offset);
+
+	/// Get the decoded data of the channel at the given index into m_ImageData
+	template <typename T>
+	std::vector<T> getChannelData(const size_t index)
+	{
+		if (index >= m_ImageData.size())
+		{
+			PSAPI_LOG_ERROR("ImageData", "Channel index %zu is out of range for the %zu channels of the merged image data", index, m_ImageData.size());
+		}
+		return m_ImageData[index]->getData<T>();
+	}
+
 	ImageData() = default;
+	ImageData(const ImageData&) = delete;
+	ImageData(ImageData&&) = default;
+	ImageData& operator=(const ImageData&) = delete;
+	ImageData& operator=(ImageData&&) = default;
 
 	/// Initialize the ImageData with a given number of channels to write out. We do this rather than deducting
 	/// from the header as the header counts alpha channels while this does not!
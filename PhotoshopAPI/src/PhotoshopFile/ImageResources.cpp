@@ -112,6 +112,18 @@ uint32_t ImageResources::parseResourceBlock(File& document)
 		m_ResourceBlocks.emplace_back(std::move(blockPtr));
 		return blockSize;
 	}
+	else if (uniqueID == Enum::ImageResource::ThumbnailResource)
+	{
+		auto blockPtr = std::make_unique<ThumbnailBlock>();
+		const bool isValid = blockPtr->read(document, blockOffset);
+		uint32_t blockSize = blockPtr->m_Size;
+		// Malformed thumbnails are dropped the same way as resources we do not parse
+		if (isValid)
+		{
+			m_ResourceBlocks.emplace_back(std::move(blockPtr));
+		}
+		return blockSize;
+	}
 	else
 	{
 		// Skip the block
@@ -5,7 +5,9 @@
 #include "Core/FileIO/Read.h"
 #include "Core/FileIO/Write.h"
 #include "Core/FileIO/Util.h"
+#include "Core/Struct/TaggedBlock.h"
 #include "StringUtil.h"
+#include "HashUtil.h"
 #include "Profiling/Perf/Instrumentor.h"
 
 #include "libdeflate.h"
@@ -13,7 +15,12 @@
 #include <variant>
 #include <algorithm>
 #include <execution>
+#include <functional>
+#include <future>
 #include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
 
 #define __STDC_FORMAT_MACROS 1
 #include <inttypes.h>
@@ -22,6 +29,217 @@
 PSAPI_NAMESPACE_BEGIN
 
 
+namespace
+{
+	// The maximum amount of channel image data requested in a single batch, this bounds the memory held at once
+	constexpr uint64_t s_MaxBatchedReadSize = 1024u * 1024u * 256u;
+
+	// Generate the coordinates of a channel from the layer extents, or from the mask extents if the channel is a mask
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	ChannelCoordinates getChannelCoordinates(const LayerRecord& layerRecord, const LayerRecords::ChannelInformation& channel, const FileHeader& header)
+	{
+		if (channel.m_ChannelID.id == Enum::ChannelID::UserSuppliedLayerMask || channel.m_ChannelID.id == Enum::ChannelID::RealUserSuppliedLayerMask)
+		{
+			if (layerRecord.m_LayerMaskData.has_value() && layerRecord.m_LayerMaskData->m_LayerMask.has_value())
+			{
+				const LayerRecords::LayerMask mask = layerRecord.m_LayerMaskData.value().m_LayerMask.value();
+				return generateChannelCoordinates(ChannelExtents(mask.m_Top, mask.m_Left, mask.m_Bottom, mask.m_Right), header);
+			}
+		}
+		return generateChannelCoordinates(ChannelExtents(layerRecord.m_Top, layerRecord.m_Left, layerRecord.m_Bottom, layerRecord.m_Right), header);
+	}
+
+	// Build the path of every layer record the same way the LayeredFile addresses them ("Group/Nested Group/Layer"). 
+	// Photoshop stores the layers bottom to top with groups being opened by their folder record and closed by a 
+	// section divider record which comes first in file order, we therefore walk the records in reverse. Section 
+	// dividers get an empty path
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	std::vector<std::string> buildLayerPaths(const std::vector<LayerRecord>& layerRecords)
+	{
+		std::vector<std::string> paths(layerRecords.size());
+		std::vector<std::string> groups;
+		for (size_t i = layerRecords.size(); i-- > 0;)
+		{
+			const LayerRecord& layerRecord = layerRecords[i];
+			std::string name = layerRecord.m_LayerName.getString();
+			std::optional<Enum::SectionDivider> sectionType;
+			if (layerRecord.m_AdditionalLayerInfo.has_value())
+			{
+				const AdditionalLayerInfo& additionalLayerInfo = layerRecord.m_AdditionalLayerInfo.value();
+				if (auto unicodeName = additionalLayerInfo.getTaggedBlock<UnicodeLayerNameTaggedBlock>(Enum::TaggedBlockKey::lrUnicodeName))
+				{
+					name = unicodeName.value()->m_Name.getString();
+				}
+				if (auto sectionDivider = additionalLayerInfo.getTaggedBlock<LrSectionTaggedBlock>(Enum::TaggedBlockKey::lrSectionDivider))
+				{
+					sectionType = sectionDivider.value()->m_Type;
+				}
+			}
+
+			if (sectionType == Enum::SectionDivider::BoundingSection)
+			{
+				if (!groups.empty())
+				{
+					groups.pop_back();
+				}
+				continue;
+			}
+			std::string path;
+			for (const auto& group : groups)
+			{
+				path += group + "/";
+			}
+			paths[i] = path + name;
+			if (sectionType == Enum::SectionDivider::OpenFolder || sectionType == Enum::SectionDivider::ClosedFolder)
+			{
+				groups.push_back(name);
+			}
+		}
+		return paths;
+	}
+
+
+	// Count the pixels of every layer over all of its channels, only counting the channels matching the predicate if given
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	std::vector<uint64_t> countLayerPixels(const std::vector<LayerRecord>& layerRecords, const FileHeader& header, const ChannelImageData::ChannelPredicate& countChannel = nullptr)
+	{
+		std::vector<uint64_t> layerPixels(layerRecords.size(), 0u);
+		for (size_t i = 0; i < layerRecords.size(); ++i)
+		{
+			for (const auto& channel : layerRecords[i].m_ChannelInformation)
+			{
+				if (countChannel && !countChannel(channel.m_ChannelID))
+				{
+					continue;
+				}
+				const ChannelCoordinates coordinates = getChannelCoordinates(layerRecords[i], channel, header);
+				layerPixels[i] += static_cast<uint64_t>(coordinates.width) * coordinates.height;
+			}
+		}
+		return layerPixels;
+	}
+
+
+	// Order the layers by the number of pixels they have to decode, largest first. Decoding a huge layer last would 
+	// otherwise leave it running on its own while every other core is already idle
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	std::vector<size_t> largestLayersFirst(const std::vector<uint64_t>& layerPixels)
+	{
+		std::vector<size_t> order(layerPixels.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return layerPixels[a] > layerPixels[b]; });
+		return order;
+	}
+
+
+	// Read the channel image data of all layers for sources which prefer batched reads (such as io_uring). Rather than 
+	// every decode worker issuing its own read we submit the reads of a whole group of layers as one batch so they can 
+	// all be in flight at once and then hand the buffers to the decode workers. The next group is read while the current 
+	// one is being decoded.
+	// 
+	// If a memory budget is given a group reserves its compressed data as well as the decoded size of its layers before 
+	// it is read and holds on to that until it is fully decoded, groups are additionally limited to fit the budget
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	void readChannelImageDataBatched(
+		File& document, 
+		const std::vector<uint64_t>& offsets, 
+		const std::vector<uint64_t>& sizes, 
+		const std::vector<size_t>& schedulePosition,
+		MemoryBudget* memoryBudget,
+		const std::vector<uint64_t>& decodedSizes,
+		const std::function<void(const size_t, ByteStream&)>& readLayer)
+	{
+		PROFILE_FUNCTION();
+		const size_t layerCount = offsets.size();
+		if (layerCount == 0)
+		{
+			return;
+		}
+
+		// Find the end of a group starting at the given index, a group always holds at least one layer
+		auto groupEnd = [&](const size_t begin)
+		{
+			size_t end = begin;
+			uint64_t groupSize = 0u;
+			uint64_t groupCost = 0u;
+			while (end < layerCount && (end == begin || (groupSize + sizes[end] <= s_MaxBatchedReadSize && 
+				(!memoryBudget || groupCost + sizes[end] + decodedSizes[end] <= memoryBudget->limit()))))
+			{
+				groupSize += sizes[end];
+				groupCost += sizes[end] + decodedSizes[end];
+				++end;
+			}
+			return end;
+		};
+		// Read the group from [begin, end) returning the buffers of its layers and the memory reserved for them
+		auto readGroup = [&](const size_t begin, const size_t end)
+		{
+			MemoryBudget::Reservation reservation;
+			if (memoryBudget)
+			{
+				uint64_t groupCost = 0u;
+				for (size_t i = begin; i < end; ++i)
+				{
+					groupCost += sizes[i] + decodedSizes[i];
+				}
+				reservation = memoryBudget->reserve(groupCost);
+			}
+			std::vector<std::vector<uint8_t>> buffers(end - begin);
+			std::vector<ByteSource::ReadRequest> requests;
+			for (size_t i = begin; i < end; ++i)
+			{
+				buffers[i - begin].resize(sizes[i]);
+				if (sizes[i] > 0)
+				{
+					requests.push_back({ reinterpret_cast<char*>(buffers[i - begin].data()), offsets[i], sizes[i] });
+				}
+			}
+			document.readBatchFromOffsets(requests);
+			return std::make_pair(std::move(buffers), std::move(reservation));
+		};
+
+		size_t begin = 0u;
+		size_t end = groupEnd(begin);
+		auto nextGroup = std::async(std::launch::async, readGroup, begin, end);
+		while (begin < layerCount)
+		{
+			// The reservation of the group is held until all of its layers are decoded
+			auto group = nextGroup.get();
+			std::vector<std::vector<uint8_t>>& buffers = group.first;
+			const size_t nextBegin = end;
+			const size_t nextEnd = groupEnd(nextBegin);
+			if (nextBegin < layerCount)
+			{
+				nextGroup = std::async(std::launch::async, readGroup, nextBegin, nextEnd);
+			}
+
+			// The groups are read in file order but within a group we start with the layers scheduled first
+			std::vector<size_t> indices(end - begin);
+			std::iota(indices.begin(), indices.end(), begin);
+			std::sort(indices.begin(), indices.end(), [&](const size_t a, const size_t b) { return schedulePosition[a] < schedulePosition[b]; });
+			#ifdef __APPLE__
+			std::for_each(indices.begin(), indices.end(), [&](const size_t index)
+			#else
+			std::for_each(std::execution::par, indices.begin(), indices.end(), [&](const size_t index)
+			#endif
+			{
+				ByteStream stream(std::move(buffers[index - begin]), offsets[index]);
+				readLayer(index, stream);
+			});
+
+			begin = nextBegin;
+			end = nextEnd;
+		}
+	}
+}
+
+
+
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 void LayerRecords::BitFlags::setFlags(const uint8_t flags) noexcept
@@ -975,7 +1193,7 @@ std::vector<std::vector<uint8_t>> ChannelImageData::compressData(const FileHeade
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord)
+void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord, const ChannelPredicate& decodeChannel)
 {
 	PROFILE_FUNCTION();
 
@@ -992,64 +1210,73 @@ void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const
 		countingOffset += channel.m_Size;
 	}
 
-	// Allocate a binary vector for the maximum extents such that we can then reuse the buffer in the loops rather than reallocating memory
-	ChannelCoordinates extent = generateChannelCoordinates(ChannelExtents(layerRecord.m_Top, layerRecord.m_Left, layerRecord.m_Bottom, layerRecord.m_Right), header);
-	uint32_t maxWidth = extent.width;
-	uint32_t maxHeight = extent.height;
-	if (layerRecord.m_LayerMaskData.has_value() && layerRecord.m_LayerMaskData->m_LayerMask.has_value())
-	{
-		const LayerRecords::LayerMask mask = layerRecord.m_LayerMaskData.value().m_LayerMask.value();
-		// Generate our coordinates from the mask extents instead
-		ChannelCoordinates lrMask = generateChannelCoordinates(ChannelExtents(mask.m_Top, mask.m_Left, mask.m_Bottom, mask.m_Right), header);
-		if (lrMask.width > maxWidth)
-			maxWidth = lrMask.width;
-		if (lrMask.height > maxHeight)
-			maxHeight = lrMask.height;
-	}
-	std::vector<uint8_t> buffer;
-	if (header.m_Depth == Enum::BitDepth::BD_8)
-		buffer = std::vector<uint8_t>(maxWidth * maxHeight * sizeof(uint8_t));
-	else if (header.m_Depth == Enum::BitDepth::BD_16)
-		buffer = std::vector<uint8_t>(maxWidth * maxHeight * sizeof(uint16_t));
+	uint64_t typeSize = sizeof(uint8_t);
+	if (header.m_Depth == Enum::BitDepth::BD_16)
+		typeSize = sizeof(uint16_t);
 	else if (header.m_Depth == Enum::BitDepth::BD_32)
-		buffer = std::vector<uint8_t>(maxWidth * maxHeight * sizeof(float32_t));
-
+		typeSize = sizeof(float32_t);
 
 	// Preallocate the ImageData vector as we need valid indices for the for each loop
 	m_ImageData.resize(layerRecord.m_ChannelInformation.size());
 	m_ChannelCompression.resize(layerRecord.m_ChannelInformation.size());
-
-	// Iterate the channels and decompress after which we generate the image channels.
-	// uses the 'buffer' as an intermediate memory area
 	for (const auto& channel : layerRecord.m_ChannelInformation)
 	{
-		const uint32_t index = &channel - &layerRecord.m_ChannelInformation[0];
+		m_Size += channel.m_Size;
+	}
+
+	// Each channel is decoded as its own task (with its own buffer) so a single large layer does not end up decoding 
+	// on a single core. The largest channels are handed to the parallel algorithm first which tends to (but is not 
+	// guaranteed to) start them first so they do not hold up the end of the read
+	std::vector<uint32_t> channelOrder(layerRecord.m_ChannelInformation.size());
+	std::vector<uint64_t> channelPixels(layerRecord.m_ChannelInformation.size());
+	for (uint32_t index = 0; index < channelOrder.size(); ++index)
+	{
+		const ChannelCoordinates coordinates = getChannelCoordinates(layerRecord, layerRecord.m_ChannelInformation[index], header);
+		channelOrder[index] = index;
+		channelPixels[index] = static_cast<uint64_t>(coordinates.width) * coordinates.height;
+	}
+	std::stable_sort(channelOrder.begin(), channelOrder.end(), [&](const uint32_t a, const uint32_t b) { return channelPixels[a] > channelPixels[b]; });
+
+	#ifdef __APPLE__
+	std::for_each(channelOrder.begin(), channelOrder.end(), [&](const uint32_t index)
+	#else
+	std::for_each(std::execution::par, channelOrder.begin(), channelOrder.end(), [&](const uint32_t index)
+	#endif
+	{
+		const LayerRecords::ChannelInformation& channel = layerRecord.m_ChannelInformation[index];
 		const uint64_t channelOffset = channelOffsets[index];
 
-		// Generate our coordinates from the layer extents
-		ChannelCoordinates coordinates = generateChannelCoordinates(ChannelExtents(layerRecord.m_Top, layerRecord.m_Left, layerRecord.m_Bottom, layerRecord.m_Right), header);
+		ChannelCoordinates coordinates = getChannelCoordinates(layerRecord, channel, header);
 
-		// If the channel is a mask the extents are actually stored in the layermaskdata
-		if (channel.m_ChannelID.id == Enum::ChannelID::UserSuppliedLayerMask || channel.m_ChannelID.id == Enum::ChannelID::RealUserSuppliedLayerMask)
-		{
-			if (layerRecord.m_LayerMaskData.has_value() && layerRecord.m_LayerMaskData->m_LayerMask.has_value())
-			{
-				const LayerRecords::LayerMask mask = layerRecord.m_LayerMaskData.value().m_LayerMask.value();
-				// Generate our coordinates from the mask extents instead
-				coordinates = generateChannelCoordinates(ChannelExtents(mask.m_Top, mask.m_Left, mask.m_Bottom, mask.m_Right), header);
-			}
-		}
 		// Get the compression of the channel. We must read it this way as the offset has to be correct before parsing
 		uint16_t compressionNum = 0;
 		stream.read(reinterpret_cast<char*>(&compressionNum), channelOffset, sizeof(uint16_t));
 		compressionNum = endianDecodeBE<uint16_t>(reinterpret_cast<const uint8_t*>(&compressionNum));
 		Enum::Compression channelCompression = Enum::compressionMap.at(compressionNum);
 		m_ChannelCompression[index] = channelCompression;
-		m_Size += channel.m_Size;
 
+		// Fingerprint the compressed bytes while they are in memory anyways, this is also done for channels we skip
+		// decoding as it is a lot cheaper than decoding them
+		const uint64_t compressedHash = hash64(stream.read(channelOffset, channel.m_Size));
+
+		if (decodeChannel && !decodeChannel(channel.m_ChannelID))
+		{
+			m_ImageData[index] = std::make_unique<ImageChannel>(
+				channelCompression,
+				channel.m_ChannelID,
+				coordinates.width,
+				coordinates.height,
+				coordinates.centerX,
+				coordinates.centerY,
+				typeSize);
+			m_ImageData[index]->m_CompressedHash = compressedHash;
+			return;
+		}
+
+		std::vector<uint8_t> buffer(channelPixels[index] * typeSize);
 		if (header.m_Depth == Enum::BitDepth::BD_8)
 		{
-			std::span<uint8_t> bufferSpan(buffer.data(), coordinates.width * coordinates.height);
+			std::span<uint8_t> bufferSpan(buffer.data(), channelPixels[index]);
 			DecompressData<uint8_t>(stream, bufferSpan, channelOffset + 2u, channelCompression, header, coordinates.width, coordinates.height, channel.m_Size - 2u);
 			auto channelPtr = std::make_unique<ImageChannel>(
 				channelCompression,
@@ -1063,7 +1290,7 @@ void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const
 		}
 		else if (header.m_Depth == Enum::BitDepth::BD_16)
 		{
-			std::span<uint16_t> bufferSpan(reinterpret_cast<uint16_t*>(buffer.data()), coordinates.width * coordinates.height);
+			std::span<uint16_t> bufferSpan(reinterpret_cast<uint16_t*>(buffer.data()), channelPixels[index]);
 			DecompressData<uint16_t>(stream, bufferSpan, channelOffset + 2u, channelCompression, header, coordinates.width, coordinates.height, channel.m_Size - 2u);
 			auto channelPtr = std::make_unique<ImageChannel>(
 				channelCompression,
@@ -1077,7 +1304,7 @@ void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const
 		}
 		if (header.m_Depth == Enum::BitDepth::BD_32)
 		{
-			std::span<float32_t> bufferSpan(reinterpret_cast<float32_t*>(buffer.data()), coordinates.width * coordinates.height);
+			std::span<float32_t> bufferSpan(reinterpret_cast<float32_t*>(buffer.data()), channelPixels[index]);
 			DecompressData<float32_t>(stream, bufferSpan, channelOffset + 2u, channelCompression, header, coordinates.width, coordinates.height, channel.m_Size - 2u);
 			auto channelPtr = std::make_unique<ImageChannel>(
 				channelCompression,
@@ -1089,6 +1316,145 @@ void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const
 				coordinates.centerY);
 			m_ImageData[index] = std::move(channelPtr);
 		}
+		if (m_ImageData[index])
+		{
+			m_ImageData[index]->m_CompressedHash = compressedHash;
+		}
+	});
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ChannelImageData::readLazy(File& document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord, const ChannelPredicate& decodeChannel)
+{
+	PROFILE_FUNCTION();
+	readDeferred(document, header, offset, layerRecord, true, decodeChannel);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ChannelImageData::readMetadata(File& document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord)
+{
+	PROFILE_FUNCTION();
+	readDeferred(document, header, offset, layerRecord, false, nullptr);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ChannelImageData::readDeferred(File& document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord, const bool withDecoder, const ChannelPredicate& decodeChannel)
+{
+
+	m_Offset = offset;
+	m_Size = 0;
+
+	// The channels hold on to the source until they are decoded so they remain valid once the document is gone
+	std::shared_ptr<ByteSource> source = withDecoder ? document.getSource() : nullptr;
+	uint64_t typeSize = sizeof(uint8_t);
+	if (header.m_Depth == Enum::BitDepth::BD_16)
+		typeSize = sizeof(uint16_t);
+	else if (header.m_Depth == Enum::BitDepth::BD_32)
+		typeSize = sizeof(float32_t);
+
+	m_ImageData.resize(layerRecord.m_ChannelInformation.size());
+	m_ChannelCompression.resize(layerRecord.m_ChannelInformation.size());
+
+	uint64_t channelOffset = offset;
+	for (const auto& channel : layerRecord.m_ChannelInformation)
+	{
+		const uint32_t index = &channel - &layerRecord.m_ChannelInformation[0];
+		m_ChannelOffsetsAndSizes.push_back(std::tuple<uint64_t, uint64_t>(channelOffset, channel.m_Size));
+
+		// The compression marker is the only part of the channel we need up front as it is what the channel gets written with
+		uint16_t compressionNum = 0;
+		document.readFromOffset(reinterpret_cast<char*>(&compressionNum), channelOffset, sizeof(uint16_t));
+		compressionNum = endianDecodeBE<uint16_t>(reinterpret_cast<const uint8_t*>(&compressionNum));
+		Enum::Compression channelCompression = Enum::compressionMap.at(compressionNum);
+		m_ChannelCompression[index] = channelCompression;
+
+		const ChannelCoordinates coordinates = getChannelCoordinates(layerRecord, channel, header);
+		if (!withDecoder || (decodeChannel && !decodeChannel(channel.m_ChannelID)))
+		{
+			m_ImageData[index] = std::make_unique<ImageChannel>(
+				channelCompression,
+				channel.m_ChannelID,
+				coordinates.width,
+				coordinates.height,
+				coordinates.centerX,
+				coordinates.centerY,
+				typeSize);
+			channelOffset += channel.m_Size;
+			m_Size += channel.m_Size;
+			continue;
+		}
+		const uint64_t dataOffset = channelOffset + 2u;
+		const uint64_t dataSize = channel.m_Size - 2u;
+		auto decoder = [source, header, channelCompression, coordinates, dataOffset, dataSize](std::span<uint8_t> buffer)
+			{
+				ByteStream stream(*source, dataOffset, dataSize);
+				const uint64_t pixelCount = static_cast<uint64_t>(coordinates.width) * coordinates.height;
+				if (header.m_Depth == Enum::BitDepth::BD_8)
+				{
+					std::span<uint8_t> bufferSpan(buffer.data(), pixelCount);
+					DecompressData<uint8_t>(stream, bufferSpan, 0u, channelCompression, header, coordinates.width, coordinates.height, dataSize);
+				}
+				else if (header.m_Depth == Enum::BitDepth::BD_16)
+				{
+					std::span<uint16_t> bufferSpan(reinterpret_cast<uint16_t*>(buffer.data()), pixelCount);
+					DecompressData<uint16_t>(stream, bufferSpan, 0u, channelCompression, header, coordinates.width, coordinates.height, dataSize);
+				}
+				else if (header.m_Depth == Enum::BitDepth::BD_32)
+				{
+					std::span<float32_t> bufferSpan(reinterpret_cast<float32_t*>(buffer.data()), pixelCount);
+					DecompressData<float32_t>(stream, bufferSpan, 0u, channelCompression, header, coordinates.width, coordinates.height, dataSize);
+				}
+			};
+		// Regions are read straight from the source so only the rows they cover are read where the compression allows for it.
+		// RLE channels hold on to their scanline offsets after the first region so e.g. iterating a channel band by band 
+		// does not have to re-read them every time
+		auto scanlineOffsets = std::make_shared<std::vector<uint64_t>>();
+		auto scanlineOffsetsFlag = std::make_shared<std::once_flag>();
+		auto regionDecoder = [source, header, channelCompression, coordinates, dataOffset, dataSize, scanlineOffsets, scanlineOffsetsFlag](std::span<uint8_t> buffer, const ChannelRegion& region)
+			{
+				if (channelCompression == Enum::Compression::Rle)
+				{
+					std::call_once(*scanlineOffsetsFlag, [&]()
+						{
+							*scanlineOffsets = RLE_Impl::ReadScanlineOffsets(*source, dataOffset, header, coordinates.height);
+						});
+				}
+				const uint64_t pixelCount = static_cast<uint64_t>(region.width) * region.height;
+				if (header.m_Depth == Enum::BitDepth::BD_8)
+				{
+					std::span<uint8_t> bufferSpan(buffer.data(), pixelCount);
+					DecompressDataRegion<uint8_t>(*source, bufferSpan, dataOffset, channelCompression, header, coordinates.width, coordinates.height, dataSize, region, *scanlineOffsets);
+				}
+				else if (header.m_Depth == Enum::BitDepth::BD_16)
+				{
+					std::span<uint16_t> bufferSpan(reinterpret_cast<uint16_t*>(buffer.data()), pixelCount);
+					DecompressDataRegion<uint16_t>(*source, bufferSpan, dataOffset, channelCompression, header, coordinates.width, coordinates.height, dataSize, region, *scanlineOffsets);
+				}
+				else if (header.m_Depth == Enum::BitDepth::BD_32)
+				{
+					std::span<float32_t> bufferSpan(reinterpret_cast<float32_t*>(buffer.data()), pixelCount);
+					DecompressDataRegion<float32_t>(*source, bufferSpan, dataOffset, channelCompression, header, coordinates.width, coordinates.height, dataSize, region, *scanlineOffsets);
+				}
+			};
+		m_ImageData[index] = std::make_unique<ImageChannel>(
+			channelCompression,
+			std::move(decoder),
+			channel.m_ChannelID,
+			coordinates.width,
+			coordinates.height,
+			coordinates.centerX,
+			coordinates.centerY,
+			typeSize,
+			std::move(regionDecoder));
+
+		channelOffset += channel.m_Size;
+		m_Size += channel.m_Size;
 	}
 }
 
@@ -1113,6 +1479,30 @@ void ChannelImageData::write(File& document, std::vector<std::vector<uint8_t>>&
 }
 
 
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ChannelImageData::write(File& document, const uint64_t offset, std::vector<std::vector<uint8_t>>& compressedChannelData, const std::vector<Enum::Compression>& channelCompression)
+{
+	m_ChannelOffsetsAndSizes = {};
+	uint64_t channelOffset = offset;
+	for (int i = 0; i < compressedChannelData.size(); ++i)
+	{
+		const uint64_t channelSize = compressedChannelData[i].size() + 2u;
+		m_ChannelCompression.push_back(channelCompression[i]);
+		m_ChannelOffsetsAndSizes.push_back(std::tuple<uint64_t, uint64_t>(channelOffset, channelSize));
+
+		std::optional<uint16_t> compressionCode = Enum::getCompression<Enum::Compression, uint16_t>(channelCompression[i]);
+		if (compressionCode.has_value()) [[likely]]
+			WriteBinaryDataToOffset<uint16_t>(document, compressionCode.value(), channelOffset);
+		else
+			PSAPI_LOG_ERROR("LayerInfo", "Could not find a match for the given compression codec");
+		WriteBinaryArrayToOffset<uint8_t>(document, std::move(compressedChannelData[i]), channelOffset + 2u);
+		compressedChannelData[i] = {};
+		channelOffset += channelSize;
+	}
+}
+
+
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 uint64_t LayerInfo::calculateSize(std::shared_ptr<FileHeader> header /*= nullptr*/) const
@@ -1167,12 +1557,21 @@ void LayerInfo::read(File& document, const FileHeader& header, ProgressCallback&
 	m_LayerRecords.reserve(layerCount);
 	m_ChannelImageData.reserve(layerCount);
 
-	// Extract layer records
-	for (int i = 0; i < layerCount; i++)
+	// Extract layer records. These consist of many tiny fields so rather than going through the shared document 
+	// for each of them we parse from a cursor over the rest of the section which fetches the records in bulk 
+	// (or views them directly) and does not need to lock. The cursor shares the document offsets so any offsets 
+	// stored on the records remain valid
 	{
-		LayerRecord layerRecord = {};
-		layerRecord.read(document, header, callback, document.getOffset());
-		m_LayerRecords.push_back(std::move(layerRecord));
+		const uint64_t recordsOffset = document.getOffset();
+		const uint64_t sectionEnd = std::min(m_Offset + m_Size, document.getSize());
+		File records(document, recordsOffset, sectionEnd - recordsOffset);
+		for (int i = 0; i < layerCount; i++)
+		{
+			LayerRecord layerRecord = {};
+			layerRecord.read(records, header, callback, records.getOffset());
+			m_LayerRecords.push_back(std::move(layerRecord));
+		}
+		document.setOffset(records.getOffset());
 	}
 
 	// Read the offsets and sizes of the channelImageData section ahead of time to later parallelize
@@ -1193,34 +1592,204 @@ void LayerInfo::read(File& document, const FileHeader& header, ProgressCallback&
 		channelImageDataSizes.push_back(imageDataSize);
 	}
 
-	// Read the Channel Image Instances
+	// Layers are decoded largest first, schedulePosition maps from a layer to its position in that order
+	const bool metadataOnly = document.metadataOnly();
+	const bool lazyChannels = document.lazyChannels() && !metadataOnly;
+	const std::vector<size_t> schedule = largestLayersFirst(countLayerPixels(m_LayerRecords, header));
+	std::vector<size_t> schedulePosition(schedule.size());
+	for (size_t i = 0; i < schedule.size(); ++i)
+	{
+		schedulePosition[schedule[i]] = i;
+	}
+
+	// If requested we let the document know which channel data we are about to read and which we are done with. 
+	// The layers are started roughly in schedule order so we prefetch a fixed window ahead of every layer we start decoding
+	const bool adviseResidency = document.adviseResidency() && !lazyChannels && !metadataOnly;
+	const size_t prefetchLayers = document.prefetchLayers();
+	if (adviseResidency)
+	{
+		for (size_t i = 0; i < std::min(prefetchLayers, schedule.size()); ++i)
+		{
+			document.advise(channelImageDataOffsets[schedule[i]], channelImageDataSizes[schedule[i]], ByteSource::Advice::WillNeed);
+		}
+	}
+
+	// If a filter was given we only decode the layers and channels it selects, all others only get their metadata read
+	const LayerFilter* layerFilter = document.getLayerFilter();
+	std::vector<uint8_t> decodeLayer(m_LayerRecords.size(), true);
+	ChannelImageData::ChannelPredicate decodeChannel = nullptr;
+	if (layerFilter)
+	{
+		const std::vector<std::string> layerPaths = buildLayerPaths(m_LayerRecords);
+		for (size_t i = 0; i < m_LayerRecords.size(); ++i)
+		{
+			decodeLayer[i] = !layerPaths[i].empty() && layerFilter->matchesLayer(m_LayerRecords[i], layerPaths[i]);
+		}
+		decodeChannel = [layerFilter](const Enum::ChannelIDInfo& channelID) { return layerFilter->matchesChannel(channelID); };
+	}
+	const ChannelImageData::ChannelPredicate decodeNoChannel = [](const Enum::ChannelIDInfo&) { return false; };
+
+	// If a memory budget was given every layer reserves the size of the buffers its channels are decoded into before
+	// it starts decoding, together with its compressed data unless that is viewed in place
+	MemoryBudget* memoryBudget = metadataOnly || lazyChannels ? nullptr : document.getDecodeMemoryBudget();
+	std::vector<uint64_t> decodedSizes(m_LayerRecords.size(), 0u);
+	if (memoryBudget)
+	{
+		uint64_t typeSize = sizeof(uint8_t);
+		if (header.m_Depth == Enum::BitDepth::BD_16)
+			typeSize = sizeof(uint16_t);
+		else if (header.m_Depth == Enum::BitDepth::BD_32)
+			typeSize = sizeof(float32_t);
+
+		const std::vector<uint64_t> decodedPixels = countLayerPixels(m_LayerRecords, header, decodeChannel);
+		for (size_t index = 0; index < m_LayerRecords.size(); ++index)
+		{
+			decodedSizes[index] = decodeLayer[index] ? decodedPixels[index] * typeSize : 0u;
+		}
+	}
+
+	// Hand every layer to the callback as soon as its channels are read so the caller may process it while the other
+	// layers are still being decoded
 	std::vector<ChannelImageData> localResults(m_LayerRecords.size());
-	#ifdef __APPLE__
-	std::for_each(   m_LayerRecords.begin(), m_LayerRecords.end(), [&](const LayerRecord& layerRecord)
-	#else
-	std::for_each(std::execution::par, m_LayerRecords.begin(), m_LayerRecords.end(), [&](const LayerRecord& layerRecord)
-	#endif
+	const File::LayerReadCallback* layerReadCallback = document.getLayerReadCallback();
+	auto notifyLayerRead = [&](const size_t index)
 	{
-		callback.setTask("Reading Layer: " + std::string(layerRecord.m_LayerName.getString()));
-		int index = &layerRecord - &m_LayerRecords[0];
+		if (layerReadCallback)
+		{
+			(*layerReadCallback)(index, m_LayerRecords[index], localResults[index]);
+		}
+	};
 
-		uint64_t tmpOffset = channelImageDataOffsets[index];
-		uint64_t tmpSize = channelImageDataSizes[index];
+	// Parse the ChannelImageData of a single layer from the stream holding its binary data
+	auto readLayer = [&](const size_t index, ByteStream& stream)
+	{
+		const size_t prefetchPosition = schedulePosition[index] + prefetchLayers;
+		if (adviseResidency && prefetchPosition < schedule.size())
+		{
+			document.advise(channelImageDataOffsets[schedule[prefetchPosition]], channelImageDataSizes[schedule[prefetchPosition]], ByteSource::Advice::WillNeed);
+		}
 
-		// Read the binary data. Note that this is done in one step to avoid the offset being set differently before 
-		// reading the data. We also do this within the loop to avoid allocating all the memory at once
-		ByteStream stream(document, tmpOffset, tmpSize);
+		const LayerRecord& layerRecord = m_LayerRecords[index];
+		callback.setTask("Reading Layer: " + std::string(layerRecord.m_LayerName.getString()));
 
-		// Create the ChannelImageData by parsing the given buffer
 		auto result = ChannelImageData();
-		result.read(stream, header, tmpOffset, layerRecord);
+		if (!decodeLayer[index] && stream.getSize() == 0u)
+		{
+			// The data of layers we skip was never fetched so we only read the compression markers
+			result.readMetadata(document, header, channelImageDataOffsets[index], layerRecord);
+		}
+		else
+		{
+			result.read(stream, header, channelImageDataOffsets[index], layerRecord, decodeLayer[index] ? decodeChannel : decodeNoChannel);
+		}
 
 		// As each index is unique we do not need to worry about locking here
 		localResults[index] = std::move(result);
+		notifyLayerRead(index);
 		// Increment the callback
 		callback.setTask("Read Layer: " + std::string(layerRecord.m_LayerName.getString()));
 		callback.increment();
-	});
+	};
+
+	// Read the Channel Image Instances
+	if (metadataOnly)
+	{
+		// The channels only describe their extents and compression, going through the layers in order keeps 
+		// this usable for streams as well
+		for (size_t index = 0; index < m_LayerRecords.size(); ++index)
+		{
+			localResults[index].readMetadata(document, header, channelImageDataOffsets[index], m_LayerRecords[index]);
+			notifyLayerRead(index);
+			callback.increment();
+		}
+	}
+	else if (lazyChannels)
+	{
+		// We only record where each channel lives, decoding is deferred until the channels are accessed
+		for (size_t index = 0; index < m_LayerRecords.size(); ++index)
+		{
+			if (decodeLayer[index])
+			{
+				localResults[index].readLazy(document, header, channelImageDataOffsets[index], m_LayerRecords[index], decodeChannel);
+			}
+			else
+			{
+				localResults[index].readMetadata(document, header, channelImageDataOffsets[index], m_LayerRecords[index]);
+			}
+			notifyLayerRead(index);
+			callback.increment();
+		}
+	}
+	else if (document.prefersBatchedReads() && document.isSeekable())
+	{
+		// Skipped layers are not fetched at all
+		std::vector<uint64_t> fetchSizes = channelImageDataSizes;
+		for (size_t index = 0; index < fetchSizes.size(); ++index)
+		{
+			fetchSizes[index] = decodeLayer[index] ? fetchSizes[index] : 0u;
+		}
+		readChannelImageDataBatched(document, channelImageDataOffsets, fetchSizes, schedulePosition, memoryBudget, decodedSizes, readLayer);
+	}
+	else
+	{
+		// Read the binary data. Note that this is done in one step to avoid the offset being set differently before 
+		// reading the data. We also do this within the loop to avoid allocating all the memory at once
+		auto readLayerFromDocument = [&](const size_t index)
+		{
+			if (decodeLayer[index])
+			{
+				ByteStream stream(document, channelImageDataOffsets[index], channelImageDataSizes[index]);
+				readLayer(index, stream);
+			}
+			else
+			{
+				ByteStream stream;
+				readLayer(index, stream);
+			}
+			// The channels are now held in their compressed in-memory representation so the mapped data may be released
+			if (adviseResidency)
+			{
+				document.advise(channelImageDataOffsets[index], channelImageDataSizes[index], ByteSource::Advice::DontNeed);
+			}
+		};
+
+		// The layers are handed out in schedule order to a fixed set of threads so the largest layers are guaranteed to be
+		// started first, which the parallel algorithms do not promise. With a memory budget this also avoids waiting on it
+		// from within the tasks of the parallel algorithms which could stall the very tasks holding the memory we wait
+		// for (a task waiting on its nested channel tasks may pick up another layer in the meantime). Each thread reserves 
+		// the memory of a layer before decoding it.
+		// 
+		// Non-seekable sources such as pipes are instead read by a single thread one layer at a time in file order. Each 
+		// layer is decoded (its channels still in parallel) as soon as its bytes arrived and released before the next one 
+		// is read, skipped layers are consumed by the source without being buffered
+		const bool inFileOrder = !document.isSeekable();
+		const bool copiesData = !document.supportsView();
+		std::atomic<size_t> nextPosition = 0u;
+		auto worker = [&]()
+		{
+			for (size_t position = nextPosition++; position < schedule.size(); position = nextPosition++)
+			{
+				const size_t index = inFileOrder ? position : schedule[position];
+				MemoryBudget::Reservation reservation;
+				if (memoryBudget)
+				{
+					const uint64_t compressedSize = decodeLayer[index] && copiesData ? channelImageDataSizes[index] : 0u;
+					reservation = memoryBudget->reserve(compressedSize + decodedSizes[index]);
+				}
+				readLayerFromDocument(index);
+			}
+		};
+		const size_t workerCount = inFileOrder ? 1u : std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), schedule.size());
+		std::vector<std::future<void>> workers;
+		for (size_t i = 0; i < workerCount; ++i)
+		{
+			workers.push_back(std::async(std::launch::async, worker));
+		}
+		for (auto& result : workers)
+		{
+			result.get();
+		}
+	}
 	// Combine results after the loop
 	m_ChannelImageData.insert(m_ChannelImageData.end(), std::make_move_iterator(localResults.begin()), std::make_move_iterator(localResults.end()));
 
@@ -1258,6 +1827,14 @@ int LayerInfo::getLayerIndex(const std::string& layerName)
 }
 
 
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::vector<std::string> LayerInfo::getLayerPaths() const
+{
+	return buildLayerPaths(m_LayerRecords);
+}
+
+
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 void LayerInfo::write(File& document, const FileHeader& header, ProgressCallback& callback, const uint16_t padding)
@@ -1342,15 +1919,39 @@ void LayerInfo::write(File& document, const FileHeader& header, ProgressCallback
 		m_LayerRecords[i].write(document, header, callback, channelInfos[i]);
 	}
 
-	// Write the ChannelImageData to disk, 
+	// Now that all the compressed sizes are known the final location of each layers' ChannelImageData is deterministic
+	// so we precompute these offsets and write all the layers in parallel without going through the files' offset marker
+	std::vector<uint64_t> channelImageDataOffsets(compressedData.size());
+	uint64_t channelImageDataEnd = document.getOffset();
 	for (int i = 0; i < compressedData.size(); ++i)
 	{
-		callback.setTask("Writing Layer: " + std::string(m_LayerRecords[i].m_LayerName.getString()));
-		m_ChannelImageData[i].write(document, compressedData[i], channelCompression[i]);
-		callback.increment();
+		channelImageDataOffsets[i] = channelImageDataEnd;
+		for (const auto& channel : compressedData[i])
+		{
+			// Each channel is prefixed by its 2 byte compression marker
+			channelImageDataEnd += channel.size() + 2u;
+		}
 	}
+	// The channel image data makes up the bulk of the document so this lets sinks preallocate (nearly) the whole output 
+	// before the layers get written in parallel
+	document.reserve(channelImageDataEnd);
+
+	#ifdef __APPLE__
+	std::for_each(m_ChannelImageData.begin(), m_ChannelImageData.end(),
+	#else
+	std::for_each(std::execution::par, m_ChannelImageData.begin(), m_ChannelImageData.end(),
+	#endif
+		[&](ChannelImageData& channel)
+		{
+			const uint32_t index = &channel - &m_ChannelImageData[0];
+			callback.setTask("Writing Layer: " + std::string(m_LayerRecords[index].m_LayerName.getString()));
+			channel.write(document, channelImageDataOffsets[index], compressedData[index], channelCompression[index]);
+			callback.increment();
+		});
+	document.setOffset(channelImageDataEnd);
 
-	// Count how many bytes we already wrote, go back to the size marker and write that information
+	// Count how many bytes we already wrote, go back to the size marker and write that information. If the marker
+	// is still held in the files' write buffer this gets patched in memory, otherwise on flush
 	uint64_t endOffset = document.getOffset();
 	uint64_t sectionSize = endOffset - sizeMarkerOffset;
 	document.setOffset(sizeMarkerOffset);
@@ -12,6 +12,7 @@
 #include "Core/Struct/ImageChannel.h"
 #include "Core/Compression/Compression.h"
 
+#include <functional>
 #include <vector>
 #include <memory>
 
@@ -285,12 +286,29 @@ struct ChannelImageData : public FileSection
 	template <typename T>
 	std::vector<std::vector<uint8_t>> compressData(const FileHeader& header, std::vector<LayerRecords::ChannelInformation>& lrChannelInfo, std::vector<Enum::Compression>& lrCompression);
 
-	/// Read a single layer instance from a pre-allocated bytestream
-	void read(ByteStream& stream, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord);
+	/// Predicate deciding whether a channel gets decoded, channels it returns false for only have their metadata read
+	using ChannelPredicate = std::function<bool(const Enum::ChannelIDInfo& channelID)>;
+
+	/// Read a single layer instance from a pre-allocated bytestream. If decodeChannel is given only the channels
+	/// it returns true for are decoded
+	void read(ByteStream& stream, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord, const ChannelPredicate& decodeChannel = nullptr);
+
+	/// Initialize the channels of a single layer without decoding them, each channel is only decoded from the
+	/// document once it is first accessed. Only the compression markers of the channels are read up front. If 
+	/// decodeChannel is given the channels it returns false for will never be decoded
+	void readLazy(File& document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord, const ChannelPredicate& decodeChannel = nullptr);
+
+	/// Initialize the channels of a single layer with their extents, size and compression but without any image data.
+	/// Only the compression markers of the channels are read
+	void readMetadata(File& document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord);
 
 	/// Write a single layer to disk, there is no need to write to a preallocated buffer here as we compress ahead of time
 	void write(File& document, std::vector<std::vector<uint8_t>>& compressedChannelData, const std::vector<Enum::Compression>& channelCompression);
 
+	/// Write a single layer to the given offset in the document without moving the files' offset marker, allowing multiple layers
+	/// to be written in parallel. The compressed data is released as soon as it is written
+	void write(File& document, const uint64_t offset, std::vector<std::vector<uint8_t>>& compressedChannelData, const std::vector<Enum::Compression>& channelCompression);
+
 	/// Get an index to a specific channel based on the identifier
 	/// returns -1 if no matching channel is found
 	int getChannelIndex(Enum::ChannelID channelID) const
@@ -375,7 +393,17 @@ struct ChannelImageData : public FileSection
 
 	/// Get the compression of a channel by logical index acquired by e.g. getChannelIndex
 	inline Enum::Compression getChannelCompression(int index) const noexcept {	return m_ChannelCompression.at(index); };
+
+	/// Get the number of channels, including any which were already extracted
+	inline size_t getChannelCount() const noexcept { return m_ImageData.size(); };
+
+	/// Get a channel by logical index acquired by e.g. getChannelIndex without taking ownership of it, this allows
+	/// reading the image data while leaving the channel in place. Returns nullptr if the channel was already extracted
+	inline ImageChannel* getChannel(int index) const { return m_ImageData.at(index).get(); };
 private:
+	/// Shared implementation of readLazy() and readMetadata(), the channels are only given a decoder if withDecoder is true
+	void readDeferred(File& document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord, const bool withDecoder, const ChannelPredicate& decodeChannel);
+
 	/// Store the offset and size of each of the compressed channels. The offset starts at the channel compression marker
 	std::vector<std::tuple<uint64_t, uint64_t>> m_ChannelOffsetsAndSizes;
 
@@ -422,6 +450,10 @@ struct LayerInfo : public FileSection
 	/// is returned (due to photoshop storing layers in reverse). 
 	/// This can also be used to get an index into the ChannelImageData vector as the indices are identical
 	int getLayerIndex(const std::string& layerName);
+
+	/// Get the path of every layer record the same way the LayeredFile addresses them, e.g. "Group/Nested Group/Layer".
+	/// The indices match the layer records, the section dividers closing a group get an empty path
+	std::vector<std::string> getLayerPaths() const;
 };
 
 
@@ -7,8 +7,12 @@
 #include "ImageData.h"
 
 
+#include "Core/FileIO/Read.h"
+#include "Core/FileIO/Util.h"
 #include "Profiling/Perf/Instrumentor.h"
 
+#include <variant>
+
 PSAPI_NAMESPACE_BEGIN
 
 
@@ -26,6 +30,30 @@ void PhotoshopFile::read(File& document, ProgressCallback& callback)
 	m_ImageResources.read(document, m_ColorModeData.m_Offset + m_ColorModeData.m_Size);
 
 	m_LayerMaskInfo.read(document, m_Header, callback, m_ImageResources.m_Offset + m_ImageResources.m_Size);
+	if (document.mergedImageData())
+	{
+		// The size of the layer and mask information does not include its length marker
+		m_ImageData.read(document, m_Header, m_LayerMaskInfo.m_Offset + SwapPsdPsb<uint32_t, uint64_t>(m_Header.m_Version) + m_LayerMaskInfo.m_Size);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void PhotoshopFile::readMergedImageData(File& document)
+{
+	PROFILE_FUNCTION();
+	m_Header.read(document);
+	m_ColorModeData.read(document);
+	m_ImageResources.read(document, m_ColorModeData.m_Offset + m_ColorModeData.m_Size);
+
+	// Skip the layer and mask information using its length marker which is 4 bytes in psd and 8 bytes in psb mode
+	const uint64_t layerMaskInfoOffset = m_ImageResources.m_Offset + m_ImageResources.m_Size;
+	document.setOffset(layerMaskInfoOffset);
+	std::variant<uint32_t, uint64_t> size = ReadBinaryDataVariadic<uint32_t, uint64_t>(document, m_Header.m_Version);
+	const uint64_t layerMaskInfoSize = ExtractWidestValue<uint32_t, uint64_t>(size) + SwapPsdPsb<uint32_t, uint64_t>(m_Header.m_Version);
+
+	m_ImageData.read(document, m_Header, layerMaskInfoOffset + layerMaskInfoSize);
 }
 
 
@@ -48,6 +76,40 @@ void PhotoshopFile::write(File& document, ProgressCallback& callback)
 	callback.setTask("Writing ImageData section");
 	m_ImageData.write(document, m_Header);
 	callback.increment();
+	// Push out whatever is still left in the write buffer
+	document.flush();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::optional<ThumbnailBlock> PhotoshopFile::readThumbnail(File& document)
+{
+	PROFILE_FUNCTION();
+	FileHeader header;
+	header.read(document);
+	ColorModeData colorModeData;
+	colorModeData.read(document);
+	ImageResources imageResources;
+	imageResources.read(document, colorModeData.m_Offset + colorModeData.m_Size);
+
+	for (auto& blockPtr : imageResources.m_ResourceBlocks)
+	{
+		if (auto thumbnailPtr = dynamic_cast<ThumbnailBlock*>(blockPtr.get()))
+		{
+			return std::move(*thumbnailPtr);
+		}
+	}
+	return std::nullopt;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::optional<ThumbnailBlock> PhotoshopFile::readThumbnail(const std::filesystem::path& filePath)
+{
+	File document(filePath);
+	return readThumbnail(document);
 }
 
 PSAPI_NAMESPACE_END
\ No newline at end of file
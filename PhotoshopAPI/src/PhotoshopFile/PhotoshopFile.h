@@ -11,6 +11,8 @@
 
 #include "Util/ProgressCallback.h"
 
+#include <filesystem>
+#include <optional>
 #include <vector>
 
 
@@ -38,18 +40,38 @@ struct PhotoshopFile
 
 	/// \brief Initialize a PhotoshopFile struct from the individual sections
 	PhotoshopFile(FileHeader header, ColorModeData colorModeData, ImageResources&& imageResources, LayerAndMaskInformation&& layerMaskInfo, ImageData imageData) :
-		m_Header(header), m_ColorModeData(colorModeData), m_ImageResources(std::move(imageResources)), m_LayerMaskInfo(std::move(layerMaskInfo)), m_ImageData(imageData) {}
+		m_Header(header), m_ColorModeData(colorModeData), m_ImageResources(std::move(imageResources)), m_LayerMaskInfo(std::move(layerMaskInfo)), m_ImageData(std::move(imageData)) {}
 
 	/// \brief Read and Initialize this struct from a File
 	///
 	/// \param document the file object to read the data from
 	void read(File& document, ProgressCallback& callback);
 
+	/// \brief Read only the merged composite of the document into m_ImageData, skipping over the layer and mask information
+	/// without parsing it. The header, color mode data and image resources are read as well while m_LayerMaskInfo stays empty.
+	///
+	/// \param document the file object to read the data from
+	void readMergedImageData(File& document);
+
 	/// \brief Write the PhotoshopFile struct to disk with an explicit progress callback
 	///
 	/// \param document the file object to write the data to
 	/// \param callback a callback which will report back the current progress of the write operation
 	void write(File& document, ProgressCallback& callback);
+
+	/// \brief Read only the preview thumbnail embedded into the image resources of the document. This parses the header,
+	/// color mode data and image resources while never touching the layer and mask information or the merged image data,
+	/// making it suitable for generating previews of a large number of documents
+	///
+	/// \param document the file object to read the thumbnail from
+	/// \return the thumbnail or std::nullopt if the document does not hold one
+	static std::optional<ThumbnailBlock> readThumbnail(File& document);
+
+	/// \brief Read only the preview thumbnail embedded into the image resources of the document at the given path
+	///
+	/// \param filePath the path to the document to read the thumbnail from
+	/// \return the thumbnail or std::nullopt if the document does not hold one
+	static std::optional<ThumbnailBlock> readThumbnail(const std::filesystem::path& filePath);
 };
 
 
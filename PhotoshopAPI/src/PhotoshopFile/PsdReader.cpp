@@ -0,0 +1,175 @@
+#include "PsdReader.h"
+
+#include "Macros.h"
+#include "Core/Struct/ByteStream.h"
+#include "Core/Struct/TaggedBlock.h"
+#include "Profiling/Perf/Instrumentor.h"
+
+#include <utility>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+namespace
+{
+	// Temporarily switches the document to reading its structure only, restoring the callers' settings on scope exit 
+	// even if the read throws
+	struct StructureReadGuard
+	{
+		File& m_Document;
+		bool m_MetadataOnly;
+		bool m_MergedImageData;
+		File::LayerReadCallback m_LayerReadCallback;
+
+		StructureReadGuard(File& document) : 
+			m_Document(document), m_MetadataOnly(document.metadataOnly()), m_MergedImageData(document.mergedImageData())
+		{
+			if (auto callback = document.getLayerReadCallback())
+			{
+				m_LayerReadCallback = *callback;
+			}
+			m_Document.setMetadataOnly(true);
+			m_Document.setMergedImageData(false);
+			m_Document.setLayerReadCallback(nullptr);
+		}
+
+		~StructureReadGuard()
+		{
+			m_Document.setMetadataOnly(m_MetadataOnly);
+			m_Document.setMergedImageData(m_MergedImageData);
+			m_Document.setLayerReadCallback(std::move(m_LayerReadCallback));
+		}
+
+		StructureReadGuard(const StructureReadGuard&) = delete;
+		StructureReadGuard& operator=(const StructureReadGuard&) = delete;
+	};
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+PsdReader::PsdReader(const std::filesystem::path& filePath, File::FileParams params)
+{
+	params.doRead = true;
+	m_OwnedDocument = std::make_unique<File>(filePath, params);
+	m_Document = m_OwnedDocument.get();
+	readStructure();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+PsdReader::PsdReader(File& document) : m_Document(&document)
+{
+	readStructure();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void PsdReader::readStructure()
+{
+	PROFILE_FUNCTION();
+	File& document = *m_Document;
+	if (!document.isSeekable())
+	{
+		PSAPI_LOG_ERROR("PsdReader", "Reading the layers one at a time requires a seekable source as the image data is read after the layer records");
+	}
+
+	// Only read the structure up front, the channels then tell us where the image data of each of the layers lives.
+	// The layer read callback is held back until next() actually reads the layers and the merged composite is never
+	// decoded as the reader only yields the layers
+	m_MetadataOnly = document.metadataOnly();
+	{
+		StructureReadGuard guard(document);
+		ProgressCallback callback{};
+		m_File.read(document, callback);
+	}
+
+	// 16 and 32 bit files store their layers in the additional layer information section
+	m_LayerInfo = &m_File.m_LayerMaskInfo.m_LayerInfo;
+	if (m_File.m_Header.m_Depth != Enum::BitDepth::BD_8 && m_File.m_LayerMaskInfo.m_AdditionalLayerInfo.has_value())
+	{
+		const AdditionalLayerInfo& additionalLayerInfo = m_File.m_LayerMaskInfo.m_AdditionalLayerInfo.value();
+		auto lr16TaggedBlock = additionalLayerInfo.getTaggedBlock<Lr16TaggedBlock>(Enum::TaggedBlockKey::Lr16);
+		auto lr32TaggedBlock = additionalLayerInfo.getTaggedBlock<Lr32TaggedBlock>(Enum::TaggedBlockKey::Lr32);
+		if (lr16TaggedBlock.has_value())
+		{
+			m_LayerInfo = &lr16TaggedBlock.value()->m_Data;
+		}
+		else if (lr32TaggedBlock.has_value())
+		{
+			m_LayerInfo = &lr32TaggedBlock.value()->m_Data;
+		}
+	}
+	if (m_LayerInfo->m_LayerRecords.size() != m_LayerInfo->m_ChannelImageData.size())
+	{
+		PSAPI_LOG_ERROR("PsdReader", "LayerRecords Size does not match channelImageDataSize. File appears to be corrupted");
+	}
+	m_LayerPaths = m_LayerInfo->getLayerPaths();
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+std::optional<PsdReader::LayerEntry> PsdReader::next()
+{
+	PROFILE_FUNCTION();
+	if (!m_LayerInfo || m_NextLayer >= m_LayerInfo->m_LayerRecords.size())
+	{
+		return std::nullopt;
+	}
+	File& document = *m_Document;
+	const FileHeader& header = m_File.m_Header;
+	const size_t index = m_NextLayer++;
+
+	// The record and channel metadata are handed over so we do not hold on to anything of the layers we yielded
+	LayerEntry entry{ index, std::move(m_LayerPaths[index]), std::move(m_LayerInfo->m_LayerRecords[index]), ChannelImageData() };
+	ChannelImageData metadata = std::move(m_LayerInfo->m_ChannelImageData[index]);
+	const uint64_t offset = metadata.m_Offset;
+	const uint64_t size = metadata.m_Size;
+
+	const bool adviseResidency = document.adviseResidency() && !m_MetadataOnly && !document.lazyChannels();
+	if (adviseResidency && m_NextLayer < m_LayerInfo->m_ChannelImageData.size())
+	{
+		const ChannelImageData& nextLayer = m_LayerInfo->m_ChannelImageData[m_NextLayer];
+		document.advise(nextLayer.m_Offset, nextLayer.m_Size, ByteSource::Advice::WillNeed);
+	}
+
+	// Layers and channels not matching the filter only keep their metadata
+	const LayerFilter* layerFilter = document.getLayerFilter();
+	ChannelImageData::ChannelPredicate decodeChannel = nullptr;
+	if (layerFilter)
+	{
+		decodeChannel = [layerFilter](const Enum::ChannelIDInfo& channelID) { return layerFilter->matchesChannel(channelID); };
+	}
+	const bool decodeLayer = !layerFilter || (!entry.path.empty() && layerFilter->matchesLayer(entry.record, entry.path));
+
+	if (m_MetadataOnly || !decodeLayer)
+	{
+		entry.channelImageData = std::move(metadata);
+	}
+	else if (document.lazyChannels())
+	{
+		entry.channelImageData.readLazy(document, header, offset, entry.record, decodeChannel);
+	}
+	else
+	{
+		ByteStream stream(document, offset, size);
+		entry.channelImageData.read(stream, header, offset, entry.record, decodeChannel);
+		// The channels are now held in their compressed in-memory representation so the mapped data may be released
+		if (adviseResidency)
+		{
+			document.advise(offset, size, ByteSource::Advice::DontNeed);
+		}
+	}
+	if (auto layerReadCallback = document.getLayerReadCallback())
+	{
+		(*layerReadCallback)(index, entry.record, entry.channelImageData);
+	}
+	return entry;
+}
+
+
+PSAPI_NAMESPACE_END
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+
+#include "PhotoshopFile.h"
+#include "FileHeader.h"
+#include "LayerAndMaskInformation.h"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+/// Pull-based reader yielding the layers of a document one at a time rather than holding the image data of every
+/// layer at once like the PhotoshopFile does. On construction only the document structure is read (the same as with
+/// FileParams::metadataOnly), every call to next() then decodes a single layer which is owned by the caller from there
+/// on and freed once they drop it. This keeps the memory bounded by the largest layer rather than the whole document,
+/// allowing e.g. very large PSB files to be processed on machines with less memory than the document holds.
+///
+/// The layers are yielded in the order they are stored in the file (bottom to top with a section divider before
+/// the layers of each group) which reads the document front to back. The source must be seekable.
+///
+/// The read settings of the document (FileParams) are honoured, layers not matching the layerFilter only have their
+/// metadata read, lazyChannels defers decoding to the first access of the channels and metadataOnly skips decoding
+/// entirely. If adviseResidency is set the next layer is prefetched while the previous one is released. The onLayerRead
+/// callback is not invoked while reading the structure but once for each layer yielded by next(). The merged composite
+/// is never decoded regardless of mergedImageData, use PhotoshopFile::readMergedImageData() for it instead.
+struct PsdReader
+{
+	/// A single layer of the document as yielded by next()
+	struct LayerEntry
+	{
+		/// The index of the layer among the layer records of the document
+		size_t index = 0u;
+		/// The path of the layer within the hierarchy the same way the LayeredFile addresses it, e.g. "Group/Layer".
+		/// Empty for the section dividers closing a group
+		std::string path;
+		/// The layer record describing the layer
+		LayerRecord record;
+		/// The channels of the layer
+		ChannelImageData channelImageData;
+	};
+
+	/// Open the document at the given path and read its structure
+	///
+	/// \param filePath the path to the document
+	/// \param params the read settings of the document
+	PsdReader(const std::filesystem::path& filePath, File::FileParams params = File::FileParams());
+
+	/// Read the structure of the given document, the document must outlive the reader
+	///
+	/// \param document the document to read from
+	PsdReader(File& document);
+
+	PsdReader(const PsdReader&) = delete;
+	PsdReader& operator=(const PsdReader&) = delete;
+
+	/// Decode the next layer of the document and hand it over to the caller
+	///
+	/// \return the layer or std::nullopt once all the layers were read
+	std::optional<LayerEntry> next();
+
+	/// The file header of the document holding e.g. its dimensions, bit depth and color mode
+	inline const FileHeader& header() const noexcept { return m_File.m_Header; }
+
+	/// The document structure without any image data, its layer records are moved out as the layers are yielded
+	inline const PhotoshopFile& file() const noexcept { return m_File; }
+
+	/// The total number of layers the document holds including the section dividers of groups
+	inline size_t layerCount() const noexcept { return m_LayerInfo ? m_LayerInfo->m_LayerRecords.size() : 0u; }
+
+	/// The number of layers which were not yet yielded by next()
+	inline size_t remainingLayers() const noexcept { return layerCount() - m_NextLayer; }
+
+private:
+	/// Only set if we opened the document ourselves
+	std::unique_ptr<File> m_OwnedDocument = nullptr;
+	File* m_Document = nullptr;
+
+	/// The structure of the document with metadata only channels
+	PhotoshopFile m_File;
+	/// Points into m_File to whichever section holds the layers, for 16- and 32-bit documents this is a tagged block
+	LayerInfo* m_LayerInfo = nullptr;
+	std::vector<std::string> m_LayerPaths;
+	size_t m_NextLayer = 0u;
+	/// Whether the channels should only report their metadata, as requested through the document
+	bool m_MetadataOnly = false;
+
+	/// Read the document structure and locate the layers
+	void readStructure();
+};
+
+
+PSAPI_NAMESPACE_END
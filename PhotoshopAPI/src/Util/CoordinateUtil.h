@@ -34,6 +34,27 @@ struct ChannelExtents
 };
 
 
+/// A rectangle of pixels within a single channel, relative to the top left of the channel (not the document)
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+struct ChannelRegion
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+
+	ChannelRegion() = default;
+	ChannelRegion(uint32_t _x, uint32_t _y, uint32_t _width, uint32_t _height) : x(_x), y(_y), width(_width), height(_height) {};
+
+	/// Whether the region lies entirely within a channel of the given size
+	bool fitsWithin(const uint32_t channelWidth, const uint32_t channelHeight) const
+	{
+		return static_cast<uint64_t>(x) + width <= channelWidth && static_cast<uint64_t>(y) + height <= channelHeight;
+	}
+};
+
+
 /// Generate Channel Coordinates as we use them in the LayeredFile from Channel Extents as present in Photoshop documents
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
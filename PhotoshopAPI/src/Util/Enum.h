@@ -258,6 +258,26 @@ namespace Enum
 		{DisplayUnit::Columns, 5u}
 	};
 
+
+	/// The encoding of the pixels stored in the thumbnail resource
+	enum class ThumbnailFormat
+	{
+		RawRGB,
+		JpegRGB
+	};
+	// Since this struct is so simple we do bidirectional mapping directly here
+	inline std::unordered_map<uint32_t, ThumbnailFormat> thumbnailFormatMap =
+	{
+		{0u, ThumbnailFormat::RawRGB},
+		{1u, ThumbnailFormat::JpegRGB}
+	};
+	// Since this struct is so simple we do bidirectional mapping directly here
+	inline std::unordered_map<ThumbnailFormat, uint32_t> thumbnailFormatMapRev =
+	{
+		{ThumbnailFormat::RawRGB, 0u},
+		{ThumbnailFormat::JpegRGB, 1u}
+	};
+
 }
 
 
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <span>
+#include <cstdint>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+namespace Hash_Impl
+{
+	constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+	constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+	constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+	inline uint64_t rotateLeft(const uint64_t value, const int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	// Read a little endian value from unaligned memory
+	template <typename T>
+	inline T readLE(const uint8_t* data)
+	{
+		T value = 0;
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			value |= static_cast<T>(data[i]) << (i * 8u);
+		}
+		return value;
+	}
+
+	inline uint64_t round(uint64_t accumulator, const uint64_t input)
+	{
+		accumulator += input * Prime2;
+		accumulator = rotateLeft(accumulator, 31);
+		return accumulator * Prime1;
+	}
+
+	inline uint64_t mergeRound(uint64_t accumulator, const uint64_t value)
+	{
+		accumulator ^= round(0u, value);
+		return accumulator * Prime1 + Prime4;
+	}
+}
+
+
+// Compute a 64-bit non-cryptographic hash of the given bytes. This is the XXH64 algorithm so the results match
+// those of the reference xxHash implementation, it runs close to memory bandwidth and is meant for fingerprinting
+// data such as compressed channels, not for security purposes
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+inline uint64_t hash64(std::span<const uint8_t> data, const uint64_t seed = 0u)
+{
+	using namespace Hash_Impl;
+
+	const uint8_t* ptr = data.data();
+	const uint8_t* end = ptr + data.size();
+	uint64_t hash = 0u;
+
+	if (data.size() >= 32u)
+	{
+		// Process the data in stripes of 32 bytes with 4 independent accumulators
+		uint64_t v1 = seed + Prime1 + Prime2;
+		uint64_t v2 = seed + Prime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - Prime1;
+		const uint8_t* limit = end - 32u;
+		do
+		{
+			v1 = round(v1, readLE<uint64_t>(ptr));
+			v2 = round(v2, readLE<uint64_t>(ptr + 8u));
+			v3 = round(v3, readLE<uint64_t>(ptr + 16u));
+			v4 = round(v4, readLE<uint64_t>(ptr + 24u));
+			ptr += 32u;
+		} while (ptr <= limit);
+
+		hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+		hash = mergeRound(hash, v1);
+		hash = mergeRound(hash, v2);
+		hash = mergeRound(hash, v3);
+		hash = mergeRound(hash, v4);
+	}
+	else
+	{
+		hash = seed + Prime5;
+	}
+	hash += static_cast<uint64_t>(data.size());
+
+	// Fold in the remaining (up to 31) bytes
+	while (end - ptr >= 8)
+	{
+		hash ^= round(0u, readLE<uint64_t>(ptr));
+		hash = rotateLeft(hash, 27) * Prime1 + Prime4;
+		ptr += 8u;
+	}
+	if (end - ptr >= 4)
+	{
+		hash ^= static_cast<uint64_t>(readLE<uint32_t>(ptr)) * Prime1;
+		hash = rotateLeft(hash, 23) * Prime2 + Prime3;
+		ptr += 4u;
+	}
+	while (ptr < end)
+	{
+		hash ^= static_cast<uint64_t>(*ptr) * Prime5;
+		hash = rotateLeft(hash, 11) * Prime1;
+		++ptr;
+	}
+
+	// Avalanche the bits so every input bit affects every output bit
+	hash ^= hash >> 33;
+	hash *= Prime2;
+	hash ^= hash >> 29;
+	hash *= Prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+
+PSAPI_NAMESPACE_END
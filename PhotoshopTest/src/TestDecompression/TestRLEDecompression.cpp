@@ -41,4 +41,31 @@ TEST_CASE("Decompress file with RLE compression")
 		std::filesystem::path combined_path = std::filesystem::current_path() / "documents/Compression/Compression_RLE_8bit.psb";
 		checkDecompressionFile<uint8_t>(combined_path, 0, 128, 255, 0);
 	}
-}
\ No newline at end of file
+}
+
+// Channels are decoded in bands of scanlines, check that a channel spanning several (and a partial last) band decodes correctly
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Decompress RLE channel spanning multiple bands")
+{
+	const uint32_t width = 300;
+	const uint32_t height = 1000;
+	std::vector<uint16_t> expected(static_cast<uint64_t>(width) * height);
+	for (uint64_t i = 0; i < expected.size(); ++i)
+	{
+		// Mix runs with literals so both paths of the PackBits decoder are used
+		expected[i] = (i / 7) % 3 == 0 ? static_cast<uint16_t>(i % 65521) : static_cast<uint16_t>(i / 64);
+	}
+	REQUIRE(NAMESPACE_PSAPI::RLE_Impl::BandHeight(width * sizeof(uint16_t), height) < height);
+
+	NAMESPACE_PSAPI::FileHeader header;
+	header.m_Version = NAMESPACE_PSAPI::Enum::Version::Psb;
+	std::vector<uint16_t> data = expected;
+	std::vector<uint8_t> compressed = NAMESPACE_PSAPI::CompressRLE(data, header, width, height);
+	const uint64_t compressedSize = compressed.size();
+
+	NAMESPACE_PSAPI::ByteStream stream(std::move(compressed), 0u);
+	std::vector<uint16_t> decompressed(expected.size());
+	NAMESPACE_PSAPI::DecompressRLE<uint16_t>(stream, decompressed, 0u, header, width, height, compressedSize);
+	CHECK(decompressed == expected);
+}
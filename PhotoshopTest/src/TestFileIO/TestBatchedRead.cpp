@@ -0,0 +1,141 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "../TestHelpers.h"
+
+#include <filesystem>
+#include <vector>
+
+
+namespace
+{
+	// In-memory source which opts into batched reads without supporting views, forcing the batched read path
+	struct BatchCountingByteSource : public NAMESPACE_PSAPI::MemoryByteSource
+	{
+		uint64_t m_NumBatches = 0u;
+		uint64_t m_NumBatchedRequests = 0u;
+
+		void readBatch(std::span<const ReadRequest> requests) override
+		{
+			++m_NumBatches;
+			m_NumBatchedRequests += requests.size();
+			ByteSource::readBatch(requests);
+		}
+		bool supportsView() const noexcept override { return false; };
+		bool prefersBatchedReads() const noexcept override { return true; };
+
+		BatchCountingByteSource(std::vector<uint8_t>&& data) : MemoryByteSource(std::move(data)) {};
+	};
+}
+
+
+TEST_CASE("Read channel image data in batches")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	LayeredFile<bpp8_t> fromDisk = LayeredFile<bpp8_t>::read(psd_path);
+
+	auto source = std::make_unique<BatchCountingByteSource>(readBytes(psd_path));
+	BatchCountingByteSource* sourcePtr = source.get();
+	File document(std::move(source));
+	REQUIRE(document.prefersBatchedReads());
+	LayeredFile<bpp8_t> batched = LayeredFile<bpp8_t>::read(document);
+
+	// All the layers fit into a single batch
+	CHECK(sourcePtr->m_NumBatches == 1u);
+	CHECK(sourcePtr->m_NumBatchedRequests > 0u);
+
+	compareImageData(fromDisk, batched);
+}
+
+
+TEST_CASE("Batched reads outside of the document are rejected")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	File document(std::make_unique<MemoryByteSource>(std::vector<uint8_t>(64u)));
+	std::vector<uint8_t> buffer(32u);
+	std::vector<ByteSource::ReadRequest> requests = { { reinterpret_cast<char*>(buffer.data()), 48u, 32u } };
+	CHECK_THROWS(document.readBatchFromOffsets(requests));
+}
+
+
+#if defined(PSAPI_USE_IO_URING) && defined(__linux__)
+TEST_CASE("Read LayeredFile through io_uring")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	LayeredFile<bpp8_t> fromMapping = LayeredFile<bpp8_t>::read(psd_path);
+
+	File::FileParams params = {};
+	params.useIoUring = true;
+	params.ioUringQueueDepth = 8u;
+	File document(psd_path, params);
+	CHECK(!document.supportsView());
+	CHECK(document.prefersBatchedReads());
+	LayeredFile<bpp8_t> fromRing = LayeredFile<bpp8_t>::read(document);
+
+	compareImageData(fromMapping, fromRing);
+}
+
+
+TEST_CASE("io_uring batches split large and many requests")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+	std::vector<uint8_t> expected = readBytes(psd_path);
+
+	// A queue depth of 2 forces the batch to cycle through the ring many times
+	IoUringByteSource source(psd_path, 2u);
+	std::vector<uint8_t> buffer(expected.size());
+	std::vector<ByteSource::ReadRequest> requests;
+	const uint64_t chunkSize = 4096u;
+	for (uint64_t offset = 0u; offset < expected.size(); offset += chunkSize)
+	{
+		const uint64_t size = std::min<uint64_t>(chunkSize, expected.size() - offset);
+		requests.push_back({ reinterpret_cast<char*>(buffer.data() + offset), offset, size });
+	}
+	source.readBatch(requests);
+	CHECK(buffer == expected);
+}
+
+
+TEST_CASE("io_uring batches drain the ring on failure")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+	std::vector<uint8_t> expected = readBytes(psd_path);
+
+	IoUringByteSource source(psd_path, 4u);
+	std::vector<uint8_t> buffer(expected.size());
+	std::vector<ByteSource::ReadRequest> requests;
+	const uint64_t chunkSize = 4096u;
+	for (uint64_t offset = 0u; offset < expected.size(); offset += chunkSize)
+	{
+		const uint64_t size = std::min<uint64_t>(chunkSize, expected.size() - offset);
+		requests.push_back({ reinterpret_cast<char*>(buffer.data() + offset), offset, size });
+	}
+	// A read past the end of the file fails while the reads around it are still in flight
+	std::vector<uint8_t> pastEnd(chunkSize);
+	std::vector<ByteSource::ReadRequest> failing = requests;
+	failing.insert(failing.begin() + 1, { reinterpret_cast<char*>(pastEnd.data()), expected.size() + chunkSize, chunkSize });
+	CHECK_THROWS(source.readBatch(failing));
+
+	// No completions of the failed batch are left over to be mistaken for those of the next one
+	std::fill(buffer.begin(), buffer.end(), 0u);
+	source.readBatch(requests);
+	CHECK(buffer == expected);
+}
+#endif
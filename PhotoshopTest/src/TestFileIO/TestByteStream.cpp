@@ -0,0 +1,56 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "Core/Struct/ByteStream.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+
+
+TEST_CASE("Zero-copy ByteStream matches copied ByteStream")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/SingleLayer/SingleLayer_8bit.psd";
+
+	File document{ psd_path };
+	REQUIRE(document.supportsView());
+
+	// Skip the file header and read a region that covers the remaining sections
+	const uint64_t offset = 26u;
+	const uint64_t size = document.getSize() - offset;
+
+	ByteStream viewStream(document, offset, size);
+	ByteStream copyStream(document, offset, size, false);
+	CHECK(viewStream.isView());
+	CHECK(!copyStream.isView());
+	CHECK(viewStream.getSize() == copyStream.getSize());
+
+	SUBCASE("Span reads are identical")
+	{
+		const uint64_t start = 0u;
+		auto viewSpan = viewStream.read(start, size);
+		auto copySpan = copyStream.read(start, size);
+		CHECK(std::equal(viewSpan.begin(), viewSpan.end(), copySpan.begin(), copySpan.end()));
+	}
+
+	SUBCASE("Buffer reads are identical")
+	{
+		std::vector<uint8_t> viewData(64u);
+		std::vector<uint8_t> copyData(64u);
+		viewStream.read(reinterpret_cast<char*>(viewData.data()), 64u);
+		copyStream.read(reinterpret_cast<char*>(copyData.data()), 64u);
+		CHECK(viewData == copyData);
+		CHECK(viewStream.getOffset() == 64u);
+	}
+
+	SUBCASE("Out of bounds reads throw")
+	{
+		const uint64_t start = 0u;
+		CHECK_THROWS(viewStream.read(start, size + 1u));
+		CHECK_THROWS(document.readViewFromOffset(offset, size + 1u));
+	}
+}
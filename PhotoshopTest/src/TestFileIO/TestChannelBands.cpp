@@ -0,0 +1,107 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+#include "../TestHelpers.h"
+
+#include <filesystem>
+#include <vector>
+
+
+namespace
+{
+	// Concatenate all the bands of the channel while checking that they are contiguous
+	template <typename T>
+	std::vector<T> collectBands(NAMESPACE_PSAPI::ImageChannel& channel, const uint64_t scratchSize)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		std::vector<T> data;
+		uint32_t nextRow = 0u;
+		auto bands = channel.bands<T>(scratchSize);
+		for (const auto& band : bands)
+		{
+			CHECK(band.y == nextRow);
+			CHECK(band.height <= bands.bandHeight());
+			CHECK(band.data.size() == static_cast<uint64_t>(band.height) * channel.getWidth());
+			CHECK(band.data.size_bytes() <= std::max<uint64_t>(scratchSize, channel.getWidth() * sizeof(T)));
+			data.insert(data.end(), band.data.begin(), band.data.end());
+			nextRow += band.height;
+		}
+		CHECK(nextRow == static_cast<uint32_t>(channel.getHeight()));
+		return data;
+	}
+
+
+	// Iterate every channel of the lazily and eagerly read file in bands of a few rows and compare to the full channel
+	template <typename T>
+	void compareBands(const std::filesystem::path& psd_path, const bool staysLazy)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		File::FileParams params;
+		params.lazyChannels = true;
+		ProgressCallback callback{};
+		LayeredFile<T> eager = LayeredFile<T>::read(psd_path);
+		LayeredFile<T> lazy = LayeredFile<T>::read(psd_path, params, callback);
+
+		compareImageData(eager, lazy, [staysLazy](ImageChannel& eagerChannel, ImageChannel& lazyChannel, ImageLayer<T>&)
+			{
+				const uint64_t scratchSize = static_cast<uint64_t>(eagerChannel.getWidth()) * sizeof(T) * 3;
+				const std::vector<T> expected = eagerChannel.getData<T>();
+				CHECK(collectBands<T>(eagerChannel, scratchSize) == expected);
+				// A scratch buffer smaller than a row still yields single rows
+				CHECK(collectBands<T>(eagerChannel, 1u) == expected);
+
+				CHECK(collectBands<T>(lazyChannel, scratchSize) == expected);
+				CHECK(lazyChannel.isLazy() == staysLazy);
+			});
+	}
+}
+
+
+TEST_CASE("Iterate channels in bands")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path documents = std::filesystem::current_path();
+	documents += "/documents/Compression/";
+
+	SUBCASE("RLE PSD")
+	{
+		compareBands<bpp8_t>(documents / "Compression_RLE_8bit.psd", true);
+	}
+	SUBCASE("RLE PSB")
+	{
+		compareBands<bpp8_t>(documents / "Compression_RLE_8bit.psb", true);
+	}
+	SUBCASE("Raw")
+	{
+		compareBands<bpp8_t>(documents / "Compression_RAW_8bit.psd", true);
+	}
+	SUBCASE("ZipPrediction 16-bit")
+	{
+		compareBands<bpp16_t>(documents / "Compression_ZipPrediction_16bit.psb", false);
+	}
+	SUBCASE("ZipPrediction 32-bit")
+	{
+		compareBands<bpp32_t>(documents / "Compression_ZipPrediction_32bit.psd", false);
+	}
+}
+
+
+TEST_CASE("Iterate the bands of an empty channel")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::vector<bpp8_t> data;
+	ImageChannel channel(Enum::Compression::Rle, data, Enum::ChannelIDInfo{ Enum::ChannelID::Red, 0 }, 0, 0, 0.0f, 0.0f);
+	uint32_t numBands = 0u;
+	for (const auto& band : channel.bands<bpp8_t>())
+	{
+		++numBands;
+	}
+	CHECK(numBands == 0u);
+}
@@ -0,0 +1,107 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+
+#include <filesystem>
+#include <memory>
+
+
+TEST_CASE("Channels are fingerprinted by their compressed data")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Compression/Compression_RLE_8bit.psd";
+
+	LayeredFile<bpp8_t> first = LayeredFile<bpp8_t>::read(psd_path);
+	LayeredFile<bpp8_t> second = LayeredFile<bpp8_t>::read(psd_path);
+	auto firstLayers = first.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	auto secondLayers = second.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	REQUIRE(firstLayers.size() == secondLayers.size());
+
+	for (size_t i = 0; i < firstLayers.size(); ++i)
+	{
+		auto firstLayer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(firstLayers[i]);
+		auto secondLayer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(secondLayers[i]);
+		if (!firstLayer)
+		{
+			continue;
+		}
+		REQUIRE(secondLayer);
+		for (const auto& [key, value] : firstLayer->m_ImageData)
+		{
+			// The hash is stable across reads and is available without decoding the channel
+			REQUIRE(value->m_CompressedHash.has_value());
+			CHECK(secondLayer->getChannelHash(key.id) == value->m_CompressedHash);
+		}
+	}
+
+	// Channels holding differing image data hash differently
+	auto layer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(firstLayers.at(0));
+	REQUIRE(layer);
+	const auto red = layer->getChannelHash(Enum::ChannelID::Red);
+	const auto green = layer->getChannelHash(Enum::ChannelID::Green);
+	const auto blue = layer->getChannelHash(Enum::ChannelID::Blue);
+	CHECK(red != green);
+	CHECK(green != blue);
+	CHECK(red != blue);
+	CHECK(layer->getChannel(Enum::ChannelID::Red) != layer->getChannel(Enum::ChannelID::Green));
+
+	// The layer does not have a mask to get the hash of
+	CHECK_FALSE(layer->getChannelHash(Enum::ChannelID::UserSuppliedLayerMask).has_value());
+}
+
+
+TEST_CASE("Mask channels are fingerprinted")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Masks/SingleMask_White.psb";
+
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(psd_path);
+	auto layers = layeredFile.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	bool hasMask = false;
+	for (const auto& layer : layers)
+	{
+		auto imageLayer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(layer);
+		if (!imageLayer || !imageLayer->m_LayerMask.has_value())
+		{
+			continue;
+		}
+		hasMask = true;
+		const auto maskHash = imageLayer->getChannelHash(Enum::ChannelID::UserSuppliedLayerMask);
+		CHECK(maskHash.has_value());
+		CHECK(maskHash == imageLayer->m_LayerMask->maskData->m_CompressedHash);
+	}
+	CHECK(hasMask);
+}
+
+
+TEST_CASE("Channels not read eagerly have no fingerprint")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Compression/Compression_RLE_8bit.psd";
+
+	File::FileParams params;
+	params.lazyChannels = true;
+	ProgressCallback callback{};
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+	for (const auto& layer : layeredFile.generateFlatLayers(std::nullopt, LayerOrder::forward))
+	{
+		auto imageLayer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(layer);
+		if (!imageLayer)
+		{
+			continue;
+		}
+		for (const auto& [key, value] : imageLayer->m_ImageData)
+		{
+			CHECK_FALSE(value->m_CompressedHash.has_value());
+		}
+	}
+}
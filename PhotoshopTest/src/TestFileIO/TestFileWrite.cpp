@@ -0,0 +1,249 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <numeric>
+#include <thread>
+
+
+namespace
+{
+	// Write the bytes 0-255 repeated to fill size bytes, then go back and patch a 4 byte marker at the 
+	// given offset, mimicking the section size markers we fill out on write
+	std::vector<uint8_t> writeAndPatch(const std::filesystem::path& path, const uint64_t bufferSize, const uint64_t size, const uint64_t patchOffset, const bool memoryMapOutput = false, const bool directIO = false)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		std::vector<uint8_t> expected(size);
+		std::iota(expected.begin(), expected.end(), static_cast<uint8_t>(0u));
+		std::vector<uint8_t> marker = { 0xDE, 0xAD, 0xBE, 0xEF };
+		std::copy(marker.begin(), marker.end(), expected.begin() + patchOffset);
+		{
+			File::FileParams params = {};
+			params.doRead = false;
+			params.forceOverwrite = true;
+			params.writeBufferSize = bufferSize;
+			params.memoryMapOutput = memoryMapOutput;
+			params.directIO = directIO;
+			File document{ path, params };
+
+			std::vector<uint8_t> data(size);
+			std::iota(data.begin(), data.end(), static_cast<uint8_t>(0u));
+			// Write in small increments to emulate the many small writes on the write path
+			for (uint64_t i = 0; i < size; i += 2)
+			{
+				document.write(std::span<uint8_t>(data.data() + i, std::min<uint64_t>(2u, size - i)));
+			}
+			uint64_t endOffset = document.getOffset();
+			document.setOffset(patchOffset);
+			document.write(marker);
+			document.setOffset(endOffset);
+			CHECK(document.getSize() == size);
+		}
+		return expected;
+	}
+
+	std::vector<uint8_t> readBack(const std::filesystem::path& path)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		File document{ path };
+		std::vector<uint8_t> data(document.getSize());
+		document.read(reinterpret_cast<char*>(data.data()), data.size());
+		return data;
+	}
+}
+
+
+TEST_CASE("Buffered write with back-patching")
+{
+	std::filesystem::path path = std::filesystem::current_path();
+	path += "/documents/Write/BufferedWrite.bin";
+
+	SUBCASE("Patch inside the pending write buffer")
+	{
+		auto expected = writeAndPatch(path, 1024u * 1024u, 4096u, 8u);
+		CHECK(readBack(path) == expected);
+	}
+
+	SUBCASE("Patch a region that was already flushed")
+	{
+		auto expected = writeAndPatch(path, 64u, 4096u, 8u);
+		CHECK(readBack(path) == expected);
+	}
+
+	SUBCASE("Patch straddling a buffer boundary")
+	{
+		auto expected = writeAndPatch(path, 64u, 4096u, 62u);
+		CHECK(readBack(path) == expected);
+	}
+
+	SUBCASE("Unbuffered")
+	{
+		auto expected = writeAndPatch(path, 0u, 4096u, 8u);
+		CHECK(readBack(path) == expected);
+	}
+
+	SUBCASE("Memory mapped output")
+	{
+		auto expected = writeAndPatch(path, 64u, 4096u, 62u, true);
+		CHECK(readBack(path) == expected);
+	}
+
+	SUBCASE("Unbuffered memory mapped output")
+	{
+		auto expected = writeAndPatch(path, 0u, 4096u, 8u, true);
+		CHECK(readBack(path) == expected);
+	}
+
+	SUBCASE("Direct I/O")
+	{
+		auto expected = writeAndPatch(path, 64u, 4096u + 17u, 62u, false, true);
+		CHECK(readBack(path) == expected);
+	}
+
+	SUBCASE("Unbuffered direct I/O")
+	{
+		auto expected = writeAndPatch(path, 0u, 4096u + 17u, 8u, false, true);
+		CHECK(readBack(path) == expected);
+	}
+}
+
+
+TEST_CASE("Parallel positional writes")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path path = std::filesystem::current_path();
+	path += "/documents/Write/PositionalWrite.bin";
+
+	constexpr uint64_t headerSize = 16u;
+	constexpr uint64_t blockSize = 1024u;
+	constexpr uint64_t numBlocks = 32u;
+	constexpr uint64_t trailerSize = 16u;
+	{
+		File::FileParams params = {};
+		params.doRead = false;
+		params.forceOverwrite = true;
+		File document{ path, params };
+
+		std::vector<uint8_t> header(headerSize, 0xFF);
+		document.write(header);
+
+		// Fill each block with its index from a separate thread
+		std::vector<std::thread> threads;
+		for (uint64_t i = 0; i < numBlocks; ++i)
+		{
+			threads.emplace_back([&document, i]()
+				{
+					std::vector<uint8_t> block(blockSize, static_cast<uint8_t>(i));
+					document.writeToOffset(block, headerSize + i * blockSize);
+				});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(document.getOffset() == headerSize);
+		CHECK(document.getSize() == headerSize + numBlocks * blockSize);
+
+		document.setOffset(headerSize + numBlocks * blockSize);
+		std::vector<uint8_t> trailer(trailerSize, 0xEE);
+		document.write(trailer);
+	}
+
+	File document{ path };
+	REQUIRE(document.getSize() == headerSize + numBlocks * blockSize + trailerSize);
+	std::vector<uint8_t> data(document.getSize());
+	document.read(reinterpret_cast<char*>(data.data()), data.size());
+	CHECK(data[0] == 0xFF);
+	for (uint64_t i = 0; i < numBlocks; ++i)
+	{
+		CHECK(data[headerSize + i * blockSize] == static_cast<uint8_t>(i));
+		CHECK(data[headerSize + (i + 1) * blockSize - 1] == static_cast<uint8_t>(i));
+	}
+	CHECK(data.back() == 0xEE);
+}
+
+
+TEST_CASE("Memory mapped output is truncated to the written size")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path path = std::filesystem::current_path();
+	path += "/documents/Write/MappedWrite.bin";
+	{
+		File::FileParams params = {};
+		params.doRead = false;
+		params.forceOverwrite = true;
+		params.memoryMapOutput = true;
+		File document{ path, params };
+
+		// Preallocate more than we end up writing
+		document.reserve(1024u * 1024u);
+		std::vector<uint8_t> data(100u, 0xAB);
+		document.write(data);
+		document.flush();
+		CHECK(std::filesystem::file_size(path) == 100u);
+	}
+	CHECK(readBack(path) == std::vector<uint8_t>(100u, 0xAB));
+}
+
+
+TEST_CASE("Memory mapped output matches regular writes")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psb";
+
+	std::filesystem::path regular_path = std::filesystem::current_path();
+	regular_path += "/documents/Write/RegularWrite.psb";
+	std::filesystem::path mapped_path = std::filesystem::current_path();
+	mapped_path += "/documents/Write/MappedWrite.psb";
+
+	LayeredFile<bpp8_t>::write(LayeredFile<bpp8_t>::read(psd_path), regular_path);
+	{
+		File::FileParams params = {};
+		params.doRead = false;
+		params.forceOverwrite = true;
+		params.memoryMapOutput = true;
+		File document{ mapped_path, params };
+		ProgressCallback callback{};
+		LayeredFile<bpp8_t>::write(LayeredFile<bpp8_t>::read(psd_path), document, Enum::Version::Psb, callback);
+	}
+	CHECK(readBack(mapped_path) == readBack(regular_path));
+}
+
+
+TEST_CASE("Direct I/O sink handles unaligned writes")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path path = std::filesystem::current_path();
+	path += "/documents/Write/DirectWrite.bin";
+
+	// A staging buffer of only two blocks forces large writes to be split up
+	constexpr uint64_t alignment = 512u;
+	std::vector<uint8_t> expected(alignment * 5u + 100u);
+	std::iota(expected.begin(), expected.end(), static_cast<uint8_t>(7u));
+	{
+		DirectFileByteSink sink(path, alignment, alignment * 2u);
+		// Unaligned start and end spanning multiple staging buffers
+		sink.write(std::span<const uint8_t>(expected.data() + 10u, expected.size() - 10u), 10u);
+		// Fill in the head afterwards, this is within a block that was already written
+		sink.write(std::span<const uint8_t>(expected.data(), 10u), 0u);
+		// Patch a few bytes straddling a block boundary
+		std::vector<uint8_t> patch = { 0xDE, 0xAD, 0xBE, 0xEF };
+		std::copy(patch.begin(), patch.end(), expected.begin() + alignment - 2u);
+		sink.write(patch, alignment - 2u);
+		sink.flush();
+		CHECK(std::filesystem::file_size(path) == expected.size());
+	}
+	CHECK(readBack(path) == expected);
+}
@@ -0,0 +1,140 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "PhotoshopFile/PhotoshopFile.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace
+{
+	// The decoded image data of every channel of a layer as seen from within the callback
+	using LayerChannels = std::unordered_map<int16_t, std::vector<NAMESPACE_PSAPI::bpp8_t>>;
+
+	// Read the document with a callback recording the name and channels of every layer it is invoked for
+	void readWithCallback(const std::filesystem::path& psd_path, NAMESPACE_PSAPI::File::FileParams params, std::vector<std::string>& names, std::vector<LayerChannels>& channels, size_t& invocations)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		std::mutex mutex;
+		invocations = 0u;
+		params.onLayerRead = [&](const size_t layerIndex, const LayerRecord& layerRecord, ChannelImageData& channelImageData)
+			{
+				LayerChannels layerChannels;
+				for (int index = 0; index < channelImageData.getChannelCount(); ++index)
+				{
+					ImageChannel* channel = channelImageData.getChannel(index);
+					if (channel && channel->hasImageData())
+					{
+						layerChannels[channel->m_ChannelID.index] = channel->getData<bpp8_t>();
+					}
+				}
+				std::lock_guard<std::mutex> guard(mutex);
+				++invocations;
+				if (layerIndex >= names.size())
+				{
+					names.resize(layerIndex + 1u);
+					channels.resize(layerIndex + 1u);
+				}
+				names[layerIndex] = layerRecord.m_LayerName.getString();
+				channels[layerIndex] = std::move(layerChannels);
+			};
+
+		File document(psd_path, params);
+		PhotoshopFile photoshopFile;
+		ProgressCallback callback{};
+		photoshopFile.read(document, callback);
+
+		const auto& layerRecords = photoshopFile.m_LayerMaskInfo.m_LayerInfo.m_LayerRecords;
+		REQUIRE(invocations == layerRecords.size());
+		REQUIRE(names.size() == layerRecords.size());
+		for (size_t i = 0; i < layerRecords.size(); ++i)
+		{
+			CHECK(names[i] == layerRecords[i].m_LayerName.getString());
+			// The channels handed to the callback are the ones the document holds on to
+			const ChannelImageData& channelImageData = photoshopFile.m_LayerMaskInfo.m_LayerInfo.m_ChannelImageData[i];
+			for (int index = 0; index < channelImageData.getChannelCount(); ++index)
+			{
+				ImageChannel* channel = channelImageData.getChannel(index);
+				if (channel && channel->hasImageData())
+				{
+					CHECK(channels[i].at(channel->m_ChannelID.index) == channel->getData<bpp8_t>());
+				}
+			}
+		}
+	}
+}
+
+
+TEST_CASE("Invoke a callback for every layer read")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	std::vector<std::string> names;
+	std::vector<LayerChannels> channels;
+	size_t invocations = 0u;
+
+	SUBCASE("Decoded")
+	{
+		readWithCallback(psd_path, File::FileParams(), names, channels, invocations);
+		CHECK(invocations > 0u);
+		bool hasImageData = false;
+		for (const auto& layerChannels : channels)
+		{
+			hasImageData |= !layerChannels.empty();
+		}
+		CHECK(hasImageData);
+	}
+	SUBCASE("Memory budget")
+	{
+		File::FileParams params;
+		params.decodeMemoryBudget = std::make_shared<MemoryBudget>(1u);
+		readWithCallback(psd_path, params, names, channels, invocations);
+		CHECK(invocations > 0u);
+	}
+	SUBCASE("Metadata only")
+	{
+		File::FileParams params;
+		params.metadataOnly = true;
+		readWithCallback(psd_path, params, names, channels, invocations);
+		CHECK(invocations > 0u);
+		for (const auto& layerChannels : channels)
+		{
+			CHECK(layerChannels.empty());
+		}
+	}
+}
+
+
+TEST_CASE("Invoke a callback for every layer read from a LayeredFile")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/SingleLayer/SingleLayer_16bit.psd";
+
+	// 16-bit documents store their layers in a tagged block which gets read the same way
+	std::mutex mutex;
+	std::vector<std::string> names;
+	File::FileParams params;
+	params.onLayerRead = [&](const size_t, const LayerRecord& layerRecord, ChannelImageData&)
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			names.push_back(layerRecord.m_LayerName.getString());
+		};
+	ProgressCallback callback{};
+	LayeredFile<bpp16_t> layeredFile = LayeredFile<bpp16_t>::read(psd_path, params, callback);
+	auto layers = layeredFile.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	REQUIRE(names.size() == layers.size());
+	CHECK(names.front() == layers.front()->m_LayerName);
+}
@@ -0,0 +1,132 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+#include "../TestHelpers.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+
+namespace
+{
+	// Check that every channel (including masks) of the lazily read file matches the eagerly read one
+	template <typename T>
+	void compareLazyImageData(NAMESPACE_PSAPI::LayeredFile<T>& eager, NAMESPACE_PSAPI::LayeredFile<T>& lazy)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		compareImageData(eager, lazy, [](ImageChannel& eagerChannel, ImageChannel& lazyChannel, ImageLayer<T>&)
+			{
+				CHECK(lazyChannel.m_Compression == eagerChannel.m_Compression);
+				CHECK(lazyChannel.m_OrigByteSize == eagerChannel.m_OrigByteSize);
+				CHECK(lazyChannel.isLazy());
+				CHECK(lazyChannel.getData<T>() == eagerChannel.getData<T>());
+				CHECK_FALSE(lazyChannel.isLazy());
+				// Once decoded the channel goes through the regular path
+				CHECK(lazyChannel.getData<T>() == eagerChannel.getData<T>());
+			});
+
+		// The masks are held separately from the channels
+		auto eagerLayers = eager.generateFlatLayers(std::nullopt, LayerOrder::forward);
+		auto lazyLayers = lazy.generateFlatLayers(std::nullopt, LayerOrder::forward);
+		for (size_t i = 0; i < eagerLayers.size(); ++i)
+		{
+			CHECK(eagerLayers[i]->getMaskData() == lazyLayers[i]->getMaskData());
+		}
+	}
+}
+
+
+TEST_CASE("Lazily read LayeredFile matches an eager read")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	File::FileParams params;
+	params.lazyChannels = true;
+	ProgressCallback callback{};
+
+	SUBCASE("8-bit")
+	{
+		std::filesystem::path psd_path = std::filesystem::current_path();
+		psd_path += "/documents/Masks/Masks_8bit.psd";
+		LayeredFile<bpp8_t> eager = LayeredFile<bpp8_t>::read(psd_path);
+		LayeredFile<bpp8_t> lazy = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+		compareLazyImageData(eager, lazy);
+	}
+	SUBCASE("16-bit")
+	{
+		std::filesystem::path psd_path = std::filesystem::current_path();
+		psd_path += "/documents/Compression/Compression_ZipPrediction_16bit.psb";
+		LayeredFile<bpp16_t> eager = LayeredFile<bpp16_t>::read(psd_path);
+		LayeredFile<bpp16_t> lazy = LayeredFile<bpp16_t>::read(psd_path, params, callback);
+		compareLazyImageData(eager, lazy);
+	}
+	SUBCASE("32-bit")
+	{
+		std::filesystem::path psd_path = std::filesystem::current_path();
+		psd_path += "/documents/Compression/Compression_ZipPrediction_32bit.psd";
+		LayeredFile<bpp32_t> eager = LayeredFile<bpp32_t>::read(psd_path);
+		LayeredFile<bpp32_t> lazy = LayeredFile<bpp32_t>::read(psd_path, params, callback);
+		compareLazyImageData(eager, lazy);
+	}
+}
+
+
+TEST_CASE("Lazily read channels keep their source alive")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Compression/Compression_RLE_8bit.psd";
+	LayeredFile<bpp8_t> eager = LayeredFile<bpp8_t>::read(psd_path);
+
+	std::unique_ptr<LayeredFile<bpp8_t>> lazy;
+	{
+		File document(psd_path);
+		document.setLazyChannels(true);
+		lazy = std::make_unique<LayeredFile<bpp8_t>>(LayeredFile<bpp8_t>::read(document));
+	}
+	// The document is gone but the channels can still be decoded
+	compareLazyImageData(eager, *lazy);
+}
+
+
+TEST_CASE("Write lazily read LayeredFile")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	File::FileParams params;
+	params.lazyChannels = true;
+	ProgressCallback callback{};
+	LayeredFile<bpp8_t> lazy = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+	std::vector<uint8_t> fromLazy = LayeredFile<bpp8_t>::writeToMemory(std::move(lazy));
+
+	LayeredFile<bpp8_t> eager = LayeredFile<bpp8_t>::read(psd_path);
+	std::vector<uint8_t> fromEager = LayeredFile<bpp8_t>::writeToMemory(std::move(eager));
+
+	CHECK(fromLazy == fromEager);
+}
+
+
+TEST_CASE("Lazy reads fall back to eager decoding for streams")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	std::ifstream stream(psd_path, std::ios::binary);
+	File document(std::make_unique<StreamByteSource>(stream));
+	document.setLazyChannels(true);
+	CHECK_FALSE(document.lazyChannels());
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(document);
+	CHECK(layeredFile.m_Layers.size() > 0);
+}
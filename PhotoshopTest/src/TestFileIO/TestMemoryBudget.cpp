@@ -0,0 +1,131 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "Core/Struct/MemoryBudget.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+#include "../TestHelpers.h"
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <vector>
+
+
+namespace
+{
+	// In-memory source which opts into batched reads without supporting views, forcing the batched read path
+	struct BatchedByteSource : public NAMESPACE_PSAPI::MemoryByteSource
+	{
+		bool supportsView() const noexcept override { return false; };
+		bool prefersBatchedReads() const noexcept override { return true; };
+
+		BatchedByteSource(std::vector<uint8_t>&& data) : MemoryByteSource(std::move(data)) {};
+	};
+
+	// The pixel count of the largest layer over all of its channels including the mask
+	uint64_t largestLayerPixels(NAMESPACE_PSAPI::LayeredFile<NAMESPACE_PSAPI::bpp8_t>& layeredFile)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		uint64_t largestLayer = 0u;
+		for (const auto& layer : layeredFile.generateFlatLayers(std::nullopt, LayerOrder::forward))
+		{
+			auto imageLayer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(layer);
+			if (!imageLayer)
+			{
+				continue;
+			}
+			uint64_t layerPixels = 0u;
+			for (auto& [key, value] : imageLayer->m_ImageData)
+			{
+				layerPixels += static_cast<uint64_t>(value->getWidth()) * value->getHeight();
+			}
+			if (imageLayer->m_LayerMask.has_value())
+			{
+				auto& mask = imageLayer->m_LayerMask->maskData;
+				layerPixels += static_cast<uint64_t>(mask->getWidth()) * mask->getHeight();
+			}
+			largestLayer = std::max(largestLayer, layerPixels);
+		}
+		return largestLayer;
+	}
+}
+
+
+TEST_CASE("Reserve memory on a budget")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	MemoryBudget budget(100u);
+	{
+		auto first = budget.reserve(60u);
+		CHECK(budget.inUse() == 60u);
+
+		// The second reservation does not fit next to the first one and has to wait for it to be released
+		auto second = std::async(std::launch::async, [&]() { return budget.reserve(60u); });
+		CHECK(second.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+		first.release();
+		MemoryBudget::Reservation reservation = second.get();
+		CHECK(reservation.size() == 60u);
+		CHECK(budget.inUse() == 60u);
+	}
+	CHECK(budget.inUse() == 0u);
+	CHECK(budget.highWaterMark() == 60u);
+
+	// Reservations larger than the budget are admitted on their own
+	{
+		auto oversized = budget.reserve(250u);
+		CHECK(budget.inUse() == 250u);
+	}
+	CHECK(budget.highWaterMark() == 250u);
+	budget.resetHighWaterMark();
+	CHECK(budget.highWaterMark() == 0u);
+}
+
+
+TEST_CASE("Read LayeredFile within a decode memory budget")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Compression/Compression_RLE_8bit.psd";
+
+	LayeredFile<bpp8_t> unbounded = LayeredFile<bpp8_t>::read(psd_path);
+	const uint64_t largestLayer = largestLayerPixels(unbounded);
+	REQUIRE(largestLayer > 0u);
+
+	SUBCASE("Memory mapped")
+	{
+		// With a budget this small every layer is decoded on its own, the channels are viewed in place so only the
+		// decoded buffers count towards the budget
+		File::FileParams params;
+		params.decodeMemoryBudget = std::make_shared<MemoryBudget>(1u);
+		ProgressCallback callback{};
+		LayeredFile<bpp8_t> bounded = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+		compareImageData(unbounded, bounded);
+		CHECK(params.decodeMemoryBudget->highWaterMark() == largestLayer);
+		CHECK(params.decodeMemoryBudget->inUse() == 0u);
+
+		// A budget fitting all the layers at once is never exceeded
+		params.decodeMemoryBudget = std::make_shared<MemoryBudget>(1024u * 1024u * 1024u);
+		LayeredFile<bpp8_t> generous = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+		compareImageData(unbounded, generous);
+		CHECK(params.decodeMemoryBudget->highWaterMark() >= largestLayer);
+		CHECK(params.decodeMemoryBudget->highWaterMark() <= params.decodeMemoryBudget->limit());
+	}
+	SUBCASE("Batched")
+	{
+		auto budget = std::make_shared<MemoryBudget>(1u);
+		File document(std::make_unique<BatchedByteSource>(readBytes(psd_path)));
+		document.setDecodeMemoryBudget(budget);
+		REQUIRE(document.getDecodeMemoryBudget() == budget.get());
+		LayeredFile<bpp8_t> bounded = LayeredFile<bpp8_t>::read(document);
+		compareImageData(unbounded, bounded);
+		// The compressed data is copied here so it counts towards the budget as well
+		CHECK(budget->highWaterMark() > largestLayer);
+		CHECK(budget->inUse() == 0u);
+	}
+}
@@ -0,0 +1,214 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "PhotoshopFile/PhotoshopFile.h"
+#include "LayeredFile/LayeredFile.h"
+#include "../TestHelpers.h"
+
+#include <filesystem>
+#include <vector>
+
+
+TEST_CASE("Read LayeredFile from memory")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	LayeredFile<bpp8_t> fromDisk = LayeredFile<bpp8_t>::read(psd_path);
+
+	SUBCASE("MemoryByteSource")
+	{
+		File document(std::make_unique<MemoryByteSource>(readBytes(psd_path)));
+		CHECK(document.getPath().empty());
+		LayeredFile<bpp8_t> fromMemory = LayeredFile<bpp8_t>::read(document);
+
+		CHECK(fromMemory.m_Width == fromDisk.m_Width);
+		CHECK(fromMemory.m_Height == fromDisk.m_Height);
+		compareImageData(fromDisk, fromMemory);
+	}
+
+	SUBCASE("CallbackByteSource")
+	{
+		std::vector<uint8_t> bytes = readBytes(psd_path);
+		uint64_t numCalls = 0u;
+		auto readFunction = [&](char* buffer, const uint64_t offset, const uint64_t size)
+			{
+				std::memcpy(buffer, bytes.data() + offset, size);
+				++numCalls;
+			};
+		File document(std::make_unique<CallbackByteSource>(readFunction, bytes.size()));
+		CHECK(!document.supportsView());
+		LayeredFile<bpp8_t> fromCallback = LayeredFile<bpp8_t>::read(document);
+
+		CHECK(numCalls > 0u);
+		compareImageData(fromDisk, fromCallback);
+	}
+}
+
+
+TEST_CASE("Write PhotoshopFile to memory")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/SingleLayer/SingleLayer_8bit.psd";
+
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(psd_path);
+	const uint64_t numLayers = layeredFile.m_Layers.size();
+	auto photoshopFile = LayeredToPhotoshopFile(std::move(layeredFile));
+
+	auto sink = std::make_unique<MemoryByteSink>();
+	MemoryByteSink* sinkPtr = sink.get();
+	{
+		File document(std::move(sink));
+		ProgressCallback callback{};
+		photoshopFile->write(document, callback);
+		// The File has to stay alive while we take the data as it owns the sink
+		std::vector<uint8_t> bytes = sinkPtr->release();
+		REQUIRE(bytes.size() > 26u);
+		// Without a path to deduce the version from we write the version stored on the header which is PSD
+		CHECK(bytes[4] == 0u);
+		CHECK(bytes[5] == 1u);
+
+		File readDocument(std::make_unique<MemoryByteSource>(std::move(bytes)));
+		LayeredFile<bpp8_t> roundtripped = LayeredFile<bpp8_t>::read(readDocument);
+		CHECK(roundtripped.m_Layers.size() == numLayers);
+	}
+}
+
+
+TEST_CASE("Skipping does not read from the source")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::vector<uint8_t> bytes(1024u * 1024u);
+	uint64_t bytesRequested = 0u;
+	auto readFunction = [&](char* buffer, const uint64_t offset, const uint64_t size)
+		{
+			std::memcpy(buffer, bytes.data() + offset, size);
+			bytesRequested += size;
+		};
+	File document(std::make_unique<CallbackByteSource>(readFunction, bytes.size()));
+
+	document.skip(static_cast<int64_t>(bytes.size() - 4u));
+	CHECK(bytesRequested == 0u);
+	CHECK(document.getOffset() == bytes.size() - 4u);
+
+	uint32_t value = 0u;
+	document.read(reinterpret_cast<char*>(&value), sizeof(value));
+	CHECK(bytesRequested == sizeof(value));
+
+	// Skipping past the end of the document is still an error
+	CHECK_THROWS(document.skip(1));
+}
+
+
+TEST_CASE("Reading a document never requests more than its size")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psb";
+
+	std::vector<uint8_t> bytes = readBytes(psd_path);
+	uint64_t bytesRequested = 0u;
+	auto readFunction = [&](char* buffer, const uint64_t offset, const uint64_t size)
+		{
+			std::memcpy(buffer, bytes.data() + offset, size);
+			bytesRequested += size;
+		};
+	File document(std::make_unique<CallbackByteSource>(readFunction, bytes.size()));
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(document);
+
+	// Unparsed tagged blocks and resources as well as the merged image data are skipped rather than read
+	CHECK(bytesRequested < bytes.size());
+}
+
+
+TEST_CASE("Region cursor fetches in bulk")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::vector<uint8_t> bytes(1024u);
+	for (size_t i = 0; i < bytes.size(); ++i)
+	{
+		bytes[i] = static_cast<uint8_t>(i);
+	}
+	uint64_t numCalls = 0u;
+	auto readFunction = [&](char* buffer, const uint64_t offset, const uint64_t size)
+		{
+			std::memcpy(buffer, bytes.data() + offset, size);
+			++numCalls;
+		};
+	File document(std::make_unique<CallbackByteSource>(readFunction, bytes.size()));
+
+	File region(document, 100u, 500u);
+	CHECK(region.getOffset() == 100u);
+	for (uint64_t i = 0; i < 500u; ++i)
+	{
+		uint8_t value = 0u;
+		region.read(reinterpret_cast<char*>(&value), sizeof(value));
+		CHECK(value == static_cast<uint8_t>(100u + i));
+	}
+	// The cursor keeps the offsets of the document and fetched the whole region at once
+	CHECK(region.getOffset() == 600u);
+	CHECK(numCalls == 1u);
+	// The document itself is not moved by reading through the cursor
+	CHECK(document.getOffset() == 0u);
+
+	uint8_t value = 0u;
+	CHECK_THROWS(region.read(reinterpret_cast<char*>(&value), sizeof(value)));
+	region.setOffset(0u);
+	CHECK_THROWS(region.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+
+TEST_CASE("Write LayeredFile to memory matches the file on disk")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	SUBCASE("PSD")
+	{
+		std::filesystem::path out_path = std::filesystem::current_path();
+		out_path += "/documents/Write/MemoryWrite_8bit.psd";
+		LayeredFile<bpp8_t>::write(LayeredFile<bpp8_t>::read(psd_path), out_path);
+
+		std::vector<uint8_t> bytes = LayeredFile<bpp8_t>::writeToMemory(LayeredFile<bpp8_t>::read(psd_path), Enum::Version::Psd);
+		CHECK(bytes == readBytes(out_path));
+	}
+	SUBCASE("PSB")
+	{
+		std::filesystem::path out_path = std::filesystem::current_path();
+		out_path += "/documents/Write/MemoryWrite_8bit.psb";
+		LayeredFile<bpp8_t>::write(LayeredFile<bpp8_t>::read(psd_path), out_path);
+
+		std::vector<uint8_t> bytes = LayeredFile<bpp8_t>::writeToMemory(LayeredFile<bpp8_t>::read(psd_path), Enum::Version::Psb);
+		CHECK(bytes == readBytes(out_path));
+	}
+	SUBCASE("User supplied sink")
+	{
+		std::vector<uint8_t> expected = LayeredFile<bpp8_t>::writeToMemory(LayeredFile<bpp8_t>::read(psd_path));
+
+		std::vector<uint8_t> buffer;
+		auto writeFunction = [&](std::span<const uint8_t> data, const uint64_t offset)
+			{
+				if (offset + data.size() > buffer.size())
+				{
+					buffer.resize(offset + data.size());
+				}
+				std::memcpy(buffer.data() + offset, data.data(), data.size());
+			};
+		{
+			File document(std::make_unique<CallbackByteSink>(writeFunction));
+			ProgressCallback callback{};
+			LayeredFile<bpp8_t>::write(LayeredFile<bpp8_t>::read(psd_path), document, Enum::Version::Psd, callback);
+		}
+		CHECK(buffer == expected);
+	}
+}
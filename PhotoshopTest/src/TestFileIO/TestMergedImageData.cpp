@@ -0,0 +1,149 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "PhotoshopFile/PhotoshopFile.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+
+namespace
+{
+	// Read the merged image data both by skipping the layers and as part of a full read and check they agree
+	template <typename T>
+	void checkMergedImageData(const std::filesystem::path& psd_path, const std::vector<T>& expectedValues, const NAMESPACE_PSAPI::Enum::Compression expectedCompression)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		File document(psd_path);
+		PhotoshopFile photoshopFile;
+		photoshopFile.readMergedImageData(document);
+		REQUIRE(photoshopFile.m_ImageData.m_ImageData.size() == expectedValues.size());
+		CHECK(photoshopFile.m_ImageData.m_Compression == expectedCompression);
+		CHECK(photoshopFile.m_LayerMaskInfo.m_LayerInfo.m_LayerRecords.empty());
+
+		const uint64_t numPixels = static_cast<uint64_t>(photoshopFile.m_Header.m_Width) * photoshopFile.m_Header.m_Height;
+		for (size_t i = 0; i < expectedValues.size(); ++i)
+		{
+			const auto& channel = photoshopFile.m_ImageData.m_ImageData[i];
+			CHECK(channel->getWidth() == photoshopFile.m_Header.m_Width);
+			CHECK(channel->getHeight() == photoshopFile.m_Header.m_Height);
+			CHECK(photoshopFile.m_ImageData.getChannelData<T>(i) == std::vector<T>(numPixels, expectedValues[i]));
+		}
+
+		File::FileParams params;
+		params.mergedImageData = true;
+		File fullDocument(psd_path, params);
+		PhotoshopFile fullFile;
+		ProgressCallback callback{};
+		fullFile.read(fullDocument, callback);
+		REQUIRE(fullFile.m_ImageData.m_ImageData.size() == expectedValues.size());
+		for (size_t i = 0; i < expectedValues.size(); ++i)
+		{
+			CHECK(fullFile.m_ImageData.getChannelData<T>(i) == photoshopFile.m_ImageData.getChannelData<T>(i));
+		}
+	}
+
+
+	// Read the merged image data from a stream of unknown size which must only consume the data the channels occupy
+	// as the section has no size marker
+	template <typename T>
+	void checkStreamedMergedImageData(const std::filesystem::path& psd_path)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		File expectedDocument(psd_path);
+		PhotoshopFile expected;
+		expected.readMergedImageData(expectedDocument);
+
+		std::ifstream stream(psd_path, std::ios::binary);
+		File document(std::make_unique<StreamByteSource>(stream));
+		PhotoshopFile photoshopFile;
+		photoshopFile.readMergedImageData(document);
+		REQUIRE(photoshopFile.m_ImageData.m_ImageData.size() == expected.m_ImageData.m_ImageData.size());
+		for (size_t i = 0; i < expected.m_ImageData.m_ImageData.size(); ++i)
+		{
+			CHECK(photoshopFile.m_ImageData.getChannelData<T>(i) == expected.m_ImageData.getChannelData<T>(i));
+		}
+		CHECK(photoshopFile.m_ImageData.m_Size == expected.m_ImageData.m_Size);
+		CHECK(photoshopFile.m_ImageData.m_Offset + photoshopFile.m_ImageData.m_Size <= std::filesystem::file_size(psd_path));
+		CHECK(document.getOffset() == photoshopFile.m_ImageData.m_Offset + photoshopFile.m_ImageData.m_Size);
+	}
+}
+
+
+TEST_CASE("Read the merged image data")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path documents = std::filesystem::current_path();
+	documents += "/documents/";
+
+	SUBCASE("RLE PSD")
+	{
+		checkMergedImageData<bpp8_t>(documents / "Compression/Compression_RLE_8bit.psd", { 255u, 128u, 0u }, Enum::Compression::Rle);
+	}
+	SUBCASE("RLE PSB")
+	{
+		checkMergedImageData<bpp8_t>(documents / "Compression/Compression_RLE_8bit.psb", { 255u, 128u, 0u }, Enum::Compression::Rle);
+	}
+	SUBCASE("RLE CMYK")
+	{
+		checkMergedImageData<bpp8_t>(documents / "CMYK/CMYK_8bit.psd", { 225u, 0u, 0u, 247u }, Enum::Compression::Rle);
+	}
+	SUBCASE("RLE with alpha channel")
+	{
+		checkMergedImageData<bpp8_t>(documents / "Masks/SingleMask_White.psb", { 255u, 255u, 255u, 0u }, Enum::Compression::Rle);
+	}
+	SUBCASE("Raw 16-bit")
+	{
+		checkMergedImageData<bpp16_t>(documents / "SingleLayer/SingleLayer_16bit.psd", { 65535u, 65535u, 65535u }, Enum::Compression::Raw);
+	}
+	SUBCASE("Raw 32-bit")
+	{
+		checkMergedImageData<bpp32_t>(documents / "SingleLayer/SingleLayer_32bit.psb", { 1.0f, 1.0f, 1.0f }, Enum::Compression::Raw);
+	}
+}
+
+
+TEST_CASE("Read a non-uniform merged image data")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Grayscale/Grayscale_8bit.psd";
+
+	File document(psd_path);
+	PhotoshopFile photoshopFile;
+	photoshopFile.readMergedImageData(document);
+	REQUIRE(photoshopFile.m_ImageData.m_ImageData.size() == 1u);
+	CHECK(photoshopFile.m_ImageData.m_ImageData[0]->m_ChannelID.id == Enum::ChannelID::Gray);
+
+	// The document holds a single layer covering the canvas so the composite matches it
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(psd_path);
+	auto layer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(layeredFile.generateFlatLayers(std::nullopt, LayerOrder::forward).at(0));
+	REQUIRE(layer);
+	CHECK(photoshopFile.m_ImageData.getChannelData<bpp8_t>(0) == layer->getChannel(Enum::ChannelID::Gray));
+}
+
+
+TEST_CASE("Read the merged image data from a stream of unknown size")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path documents = std::filesystem::current_path();
+	documents += "/documents/";
+
+	SUBCASE("RLE PSB")
+	{
+		checkStreamedMergedImageData<bpp8_t>(documents / "Compression/Compression_RLE_8bit.psb");
+	}
+	SUBCASE("Raw 16-bit")
+	{
+		checkStreamedMergedImageData<bpp16_t>(documents / "SingleLayer/SingleLayer_16bit.psd");
+	}
+}
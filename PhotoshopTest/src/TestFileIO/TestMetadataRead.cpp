@@ -0,0 +1,95 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+#include "../TestHelpers.h"
+
+#include <atomic>
+#include <filesystem>
+#include <vector>
+
+
+TEST_CASE("Metadata-only read matches the structure of a full read")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Masks/Masks_8bit.psd";
+
+	File::FileParams params;
+	params.metadataOnly = true;
+	ProgressCallback callback{};
+	LayeredFile<bpp8_t> metadata = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+	LayeredFile<bpp8_t> full = LayeredFile<bpp8_t>::read(psd_path);
+
+	auto metadataLayers = metadata.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	auto fullLayers = full.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	REQUIRE(metadataLayers.size() == fullLayers.size());
+	for (size_t i = 0; i < fullLayers.size(); ++i)
+	{
+		CHECK(metadataLayers[i]->m_LayerName == fullLayers[i]->m_LayerName);
+		CHECK(metadataLayers[i]->m_BlendMode == fullLayers[i]->m_BlendMode);
+		CHECK(metadataLayers[i]->m_IsVisible == fullLayers[i]->m_IsVisible);
+		CHECK(metadataLayers[i]->m_Width == fullLayers[i]->m_Width);
+		CHECK(metadataLayers[i]->m_Height == fullLayers[i]->m_Height);
+		REQUIRE(metadataLayers[i]->m_LayerMask.has_value() == fullLayers[i]->m_LayerMask.has_value());
+		if (fullLayers[i]->m_LayerMask.has_value())
+		{
+			CHECK(metadataLayers[i]->m_LayerMask->defaultColor == fullLayers[i]->m_LayerMask->defaultColor);
+			CHECK(metadataLayers[i]->m_LayerMask->maskData->getWidth() == fullLayers[i]->m_LayerMask->maskData->getWidth());
+			CHECK_FALSE(metadataLayers[i]->m_LayerMask->maskData->hasImageData());
+		}
+
+		auto metadataImageLayer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(metadataLayers[i]);
+		auto fullImageLayer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(fullLayers[i]);
+		REQUIRE((metadataImageLayer == nullptr) == (fullImageLayer == nullptr));
+		if (!fullImageLayer)
+		{
+			continue;
+		}
+		REQUIRE(metadataImageLayer->m_ImageData.size() == fullImageLayer->m_ImageData.size());
+		for (auto& [key, value] : fullImageLayer->m_ImageData)
+		{
+			auto& channel = metadataImageLayer->m_ImageData.at(key);
+			CHECK(channel->m_Compression == value->m_Compression);
+			CHECK(channel->m_OrigByteSize == value->m_OrigByteSize);
+			CHECK(channel->getWidth() == value->getWidth());
+			CHECK(channel->getHeight() == value->getHeight());
+			CHECK_FALSE(channel->hasImageData());
+			CHECK(value->hasImageData());
+			CHECK(channel->getData<bpp8_t>().empty());
+		}
+	}
+}
+
+
+TEST_CASE("Metadata-only read skips the channel image data")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_16bit.psd";
+	std::vector<uint8_t> data = readBytes(psd_path);
+
+	// Count the bytes requested from the source for a full and a metadata-only read
+	auto countBytesRead = [&](const bool metadataOnly)
+		{
+			std::atomic<uint64_t> bytesRead = 0u;
+			auto source = std::make_unique<CallbackByteSource>([&](char* buffer, const uint64_t offset, const uint64_t size)
+				{
+					std::memcpy(buffer, data.data() + offset, size);
+					bytesRead += size;
+				}, data.size());
+			File document(std::move(source));
+			document.setMetadataOnly(metadataOnly);
+			LayeredFile<bpp16_t> layeredFile = LayeredFile<bpp16_t>::read(document);
+			CHECK(layeredFile.m_Layers.size() > 0);
+			return bytesRead.load();
+		};
+
+	const uint64_t fullBytes = countBytesRead(false);
+	const uint64_t metadataBytes = countBytesRead(true);
+	CHECK(metadataBytes < fullBytes);
+}
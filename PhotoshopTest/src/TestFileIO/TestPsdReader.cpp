@@ -0,0 +1,212 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/ByteSource.h"
+#include "Core/Struct/File.h"
+#include "Core/Struct/LayerFilter.h"
+#include "Core/Struct/TaggedBlock.h"
+#include "PhotoshopFile/PhotoshopFile.h"
+#include "PhotoshopFile/PsdReader.h"
+#include "../TestHelpers.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	// Read the document both in full and one layer at a time through the PsdReader and check the layers agree
+	template <typename T>
+	void compareWithPhotoshopFile(const std::filesystem::path& psd_path, const NAMESPACE_PSAPI::Enum::BitDepth bitDepth)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		File document(psd_path);
+		PhotoshopFile photoshopFile;
+		ProgressCallback callback{};
+		photoshopFile.read(document, callback);
+		LayerInfo* layerInfo = &photoshopFile.m_LayerMaskInfo.m_LayerInfo;
+		if (bitDepth == Enum::BitDepth::BD_16)
+		{
+			layerInfo = &photoshopFile.m_LayerMaskInfo.m_AdditionalLayerInfo->getTaggedBlock<Lr16TaggedBlock>(Enum::TaggedBlockKey::Lr16).value()->m_Data;
+		}
+		else if (bitDepth == Enum::BitDepth::BD_32)
+		{
+			layerInfo = &photoshopFile.m_LayerMaskInfo.m_AdditionalLayerInfo->getTaggedBlock<Lr32TaggedBlock>(Enum::TaggedBlockKey::Lr32).value()->m_Data;
+		}
+		const std::vector<std::string> layerPaths = layerInfo->getLayerPaths();
+
+		PsdReader reader(psd_path);
+		CHECK(reader.header().m_Depth == bitDepth);
+		REQUIRE(reader.layerCount() == layerInfo->m_LayerRecords.size());
+		REQUIRE(reader.layerCount() > 0u);
+
+		size_t count = 0u;
+		while (auto layer = reader.next())
+		{
+			REQUIRE(layer->index == count);
+			CHECK(layer->path == layerPaths[count]);
+			CHECK(layer->record.m_LayerName.getString() == layerInfo->m_LayerRecords[count].m_LayerName.getString());
+
+			const ChannelImageData& expected = layerInfo->m_ChannelImageData[count];
+			REQUIRE(layer->channelImageData.getChannelCount() == expected.getChannelCount());
+			for (int index = 0; index < expected.getChannelCount(); ++index)
+			{
+				ImageChannel* expectedChannel = expected.getChannel(index);
+				ImageChannel* channel = layer->channelImageData.getChannel(index);
+				REQUIRE(channel);
+				CHECK(channel->m_ChannelID == expectedChannel->m_ChannelID);
+				CHECK(channel->getData<T>() == expectedChannel->getData<T>());
+			}
+			++count;
+			CHECK(reader.remainingLayers() == reader.layerCount() - count);
+		}
+		CHECK(count == reader.layerCount());
+		CHECK_FALSE(reader.next().has_value());
+	}
+}
+
+
+TEST_CASE("Read the layers of a document one at a time")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path documents = std::filesystem::current_path();
+	documents += "/documents/";
+
+	SUBCASE("8-bit groups")
+	{
+		compareWithPhotoshopFile<bpp8_t>(documents / "Groups/Groups_8bit.psd", Enum::BitDepth::BD_8);
+	}
+	SUBCASE("8-bit PSB with masks")
+	{
+		compareWithPhotoshopFile<bpp8_t>(documents / "Masks/SingleMask_White.psb", Enum::BitDepth::BD_8);
+	}
+	SUBCASE("16-bit")
+	{
+		compareWithPhotoshopFile<bpp16_t>(documents / "SingleLayer/SingleLayer_16bit.psd", Enum::BitDepth::BD_16);
+	}
+	SUBCASE("32-bit")
+	{
+		compareWithPhotoshopFile<bpp32_t>(documents / "SingleLayer/SingleLayer_32bit.psb", Enum::BitDepth::BD_32);
+	}
+}
+
+
+TEST_CASE("Read the layers of a document one at a time with a filter")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	// Layers not matching the filter as well as section dividers only hold their metadata
+	LayerFilter filter;
+	filter.m_Paths = { "GroupTopLevel/CollapsedGroup/*" };
+	File::FileParams params;
+	params.layerFilter = filter;
+	PsdReader reader(psd_path, params);
+	size_t decoded = 0u;
+	while (auto layer = reader.next())
+	{
+		bool hasImageData = false;
+		for (int index = 0; index < layer->channelImageData.getChannelCount(); ++index)
+		{
+			hasImageData |= layer->channelImageData.getChannel(index)->hasImageData();
+		}
+		if (hasImageData)
+		{
+			CHECK(LayerFilter::matchesGlob(filter.m_Paths[0], layer->path));
+			++decoded;
+		}
+	}
+	CHECK(decoded > 0u);
+}
+
+
+TEST_CASE("Read only the metadata of the layers one at a time")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	File::FileParams params;
+	params.metadataOnly = true;
+	PsdReader reader(psd_path, params);
+	size_t count = 0u;
+	while (auto layer = reader.next())
+	{
+		for (int index = 0; index < layer->channelImageData.getChannelCount(); ++index)
+		{
+			CHECK_FALSE(layer->channelImageData.getChannel(index)->hasImageData());
+		}
+		++count;
+	}
+	CHECK(count == reader.layerCount());
+}
+
+
+TEST_CASE("The layer read callback fires for the layers yielded by the PsdReader")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	std::vector<size_t> indices;
+	File::FileParams params;
+	params.onLayerRead = [&](const size_t layerIndex, const LayerRecord&, ChannelImageData&) { indices.push_back(layerIndex); };
+	PsdReader reader(psd_path, params);
+	// Reading the structure does not count as reading the layers
+	CHECK(indices.empty());
+	size_t count = 0u;
+	while (auto layer = reader.next())
+	{
+		REQUIRE(indices.size() == count + 1u);
+		CHECK(indices.back() == layer->index);
+		++count;
+	}
+	CHECK(indices.size() == reader.layerCount());
+}
+
+
+TEST_CASE("The PsdReader does not decode the merged image data")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	File document(std::make_unique<MemoryByteSource>(readBytes(psd_path)));
+	document.setMergedImageData(true);
+	PsdReader reader(document);
+	CHECK(reader.file().m_ImageData.m_ImageData.empty());
+	// The setting is handed back to the document once the structure is read
+	CHECK(document.mergedImageData());
+}
+
+
+TEST_CASE("The PsdReader restores the document settings if reading the structure fails")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	// Cut the document off within the layer records
+	std::vector<uint8_t> data = readBytes(psd_path);
+	data.resize(data.size() / 2u);
+	File document(std::make_unique<MemoryByteSource>(std::move(data)));
+	document.setMetadataOnly(false);
+	document.setMergedImageData(true);
+	bool invoked = false;
+	document.setLayerReadCallback([&](const size_t, const LayerRecord&, ChannelImageData&) { invoked = true; });
+
+	CHECK_THROWS(PsdReader(document));
+	CHECK_FALSE(document.metadataOnly());
+	CHECK(document.mergedImageData());
+	CHECK(document.getLayerReadCallback() != nullptr);
+	CHECK_FALSE(invoked);
+}
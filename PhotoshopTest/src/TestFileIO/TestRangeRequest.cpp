@@ -0,0 +1,181 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "../TestHelpers.h"
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+	// Stand-in for an object store serving byte ranges of a document which counts the requests made
+	struct RangeServer
+	{
+		std::vector<uint8_t> m_Data;
+		std::atomic<uint64_t> m_NumRequests = 0u;
+
+		NAMESPACE_PSAPI::RangeRequestByteSource::FetchFunction fetchFunction()
+		{
+			return [this](char* buffer, const uint64_t offset, const uint64_t size)
+				{
+					REQUIRE(offset + size <= m_Data.size());
+					std::memcpy(buffer, m_Data.data() + offset, size);
+					++m_NumRequests;
+				};
+		}
+	};
+}
+
+
+TEST_CASE("Read LayeredFile through ranged requests")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psb";
+
+	LayeredFile<bpp8_t> fromDisk = LayeredFile<bpp8_t>::read(psd_path);
+
+	RangeServer server;
+	server.m_Data = readBytes(psd_path);
+	RangeRequestByteSource::Params params;
+	params.blockSize = 4096u;
+	auto source = std::make_unique<RangeRequestByteSource>(server.fetchFunction(), server.m_Data.size(), params);
+	RangeRequestByteSource* sourcePtr = source.get();
+	File document(std::move(source));
+	LayeredFile<bpp8_t> fromRanges = LayeredFile<bpp8_t>::read(document);
+
+	REQUIRE(fromRanges.m_Layers.size() == fromDisk.m_Layers.size());
+	for (size_t i = 0; i < fromDisk.m_Layers.size(); ++i)
+	{
+		CHECK(fromRanges.m_Layers[i]->m_LayerName == fromDisk.m_Layers[i]->m_LayerName);
+	}
+
+	// Rather than one request per field we only fetch a handful of blocks and one coalesced range for the channel data
+	RangeRequestByteSource::Stats stats = sourcePtr->getStats();
+	CHECK(stats.requests == server.m_NumRequests);
+	CHECK(stats.requests < 32u);
+	CHECK(stats.cacheHits > stats.cacheMisses);
+}
+
+
+TEST_CASE("Ranged requests are coalesced")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	RangeServer server;
+	server.m_Data.resize(1024u * 1024u);
+	for (size_t i = 0; i < server.m_Data.size(); ++i)
+	{
+		server.m_Data[i] = static_cast<uint8_t>(i * 7u);
+	}
+	RangeRequestByteSource::Params params;
+	params.coalesceGap = 100u;
+	RangeRequestByteSource source(server.fetchFunction(), server.m_Data.size(), params);
+
+	std::vector<uint8_t> a(1000u), b(1000u), c(1000u);
+	std::vector<ByteSource::ReadRequest> requests = {
+		{ reinterpret_cast<char*>(c.data()), 500000u, c.size() },	// Far from the others
+		{ reinterpret_cast<char*>(b.data()), 1050u, b.size() },		// Within the gap of the first one
+		{ reinterpret_cast<char*>(a.data()), 0u, a.size() },
+	};
+	source.readBatch(requests);
+
+	CHECK(server.m_NumRequests == 2u);
+	CHECK(std::equal(a.begin(), a.end(), server.m_Data.begin()));
+	CHECK(std::equal(b.begin(), b.end(), server.m_Data.begin() + 1050u));
+	CHECK(std::equal(c.begin(), c.end(), server.m_Data.begin() + 500000u));
+}
+
+
+TEST_CASE("Small ranged reads are served from the block cache")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	RangeServer server;
+	server.m_Data.resize(1024u * 64u);
+	for (size_t i = 0; i < server.m_Data.size(); ++i)
+	{
+		server.m_Data[i] = static_cast<uint8_t>(i);
+	}
+	RangeRequestByteSource::Params params;
+	params.blockSize = 1024u;
+	params.cacheBlocks = 2u;
+	RangeRequestByteSource source(server.fetchFunction(), server.m_Data.size(), params);
+
+	// Straddles the first two blocks which are fetched with a single request
+	std::vector<uint8_t> buffer(100u);
+	source.read(reinterpret_cast<char*>(buffer.data()), 1000u, buffer.size());
+	CHECK(std::equal(buffer.begin(), buffer.end(), server.m_Data.begin() + 1000u));
+	CHECK(server.m_NumRequests == 1u);
+	CHECK(source.getStats().cacheMisses == 2u);
+	CHECK(source.getStats().cacheHits == 0u);
+
+	source.read(reinterpret_cast<char*>(buffer.data()), 0u, buffer.size());
+	source.read(reinterpret_cast<char*>(buffer.data()), 1500u, buffer.size());
+	CHECK(server.m_NumRequests == 1u);
+	CHECK(source.getStats().cacheMisses == 2u);
+	CHECK(source.getStats().cacheHits == 2u);
+
+	// Fetching a third block evicts the least recently used one
+	source.read(reinterpret_cast<char*>(buffer.data()), 2048u, buffer.size());
+	CHECK(server.m_NumRequests == 2u);
+	source.read(reinterpret_cast<char*>(buffer.data()), 0u, buffer.size());
+	CHECK(server.m_NumRequests == 3u);
+	CHECK(std::equal(buffer.begin(), buffer.end(), server.m_Data.begin()));
+	CHECK(source.getStats().cacheMisses == 4u);
+	CHECK(source.getStats().cacheHits == 2u);
+
+	// Reads of at least a block bypass the cache
+	std::vector<uint8_t> large(4096u);
+	source.read(reinterpret_cast<char*>(large.data()), 10000u, large.size());
+	CHECK(server.m_NumRequests == 4u);
+	CHECK(std::equal(large.begin(), large.end(), server.m_Data.begin() + 10000u));
+}
+
+
+TEST_CASE("Concurrent small ranged reads fetch each block once")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::vector<uint8_t> data(1024u * 8u);
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<uint8_t>(i * 7u);
+	}
+	// A slow fetch so the readers overlap while the blocks are being fetched
+	std::atomic<uint64_t> numRequests = 0u;
+	auto fetchFunction = [&](char* buffer, const uint64_t offset, const uint64_t size)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			std::memcpy(buffer, data.data() + offset, size);
+			++numRequests;
+		};
+	RangeRequestByteSource::Params params;
+	params.blockSize = 1024u;
+	RangeRequestByteSource source(fetchFunction, data.size(), params);
+
+	std::vector<std::vector<uint8_t>> buffers(8u, std::vector<uint8_t>(200u));
+	std::vector<std::thread> threads;
+	for (auto& buffer : buffers)
+	{
+		threads.emplace_back([&source, &buffer]() { source.read(reinterpret_cast<char*>(buffer.data()), 900u, buffer.size()); });
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	for (const auto& buffer : buffers)
+	{
+		CHECK(std::equal(buffer.begin(), buffer.end(), data.begin() + 900u));
+	}
+	CHECK(numRequests == 1u);
+	const auto stats = source.getStats();
+	CHECK(stats.cacheMisses == 2u);
+	CHECK(stats.cacheHits == 2u * (buffers.size() - 1u));
+}
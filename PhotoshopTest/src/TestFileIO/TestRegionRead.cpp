@@ -0,0 +1,156 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+#include "../TestHelpers.h"
+
+#include <atomic>
+#include <filesystem>
+#include <vector>
+
+
+namespace
+{
+	template <typename T>
+	std::vector<T> cropRegion(const std::vector<T>& data, const uint32_t width, const NAMESPACE_PSAPI::ChannelRegion region)
+	{
+		std::vector<T> cropped;
+		for (uint64_t y = region.y; y < region.y + region.height; ++y)
+		{
+			cropped.insert(cropped.end(), data.begin() + y * width + region.x, data.begin() + y * width + region.x + region.width);
+		}
+		return cropped;
+	}
+
+
+	// Check that regions of every channel of the lazily and eagerly read files match the crop of the full channel
+	template <typename T>
+	void compareRegions(const std::filesystem::path& psd_path)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		File::FileParams params;
+		params.lazyChannels = true;
+		ProgressCallback callback{};
+		LayeredFile<T> eager = LayeredFile<T>::read(psd_path);
+		LayeredFile<T> lazy = LayeredFile<T>::read(psd_path, params, callback);
+
+		compareImageData(eager, lazy, [](ImageChannel& eagerChannel, ImageChannel& lazyChannel, ImageLayer<T>& lazyImageLayer)
+			{
+				const uint32_t width = eagerChannel.getWidth();
+				const uint32_t height = eagerChannel.getHeight();
+				const ChannelRegion region(width / 4, height / 3, width / 2, height / 2);
+				const std::vector<T> expected = cropRegion(eagerChannel.getData<T>(), width, region);
+
+				CHECK(lazyChannel.getRegion<T>(region) == expected);
+				// Decoding a region does not decode the whole channel
+				CHECK(lazyChannel.isLazy());
+				CHECK(eagerChannel.getRegion<T>(region) == expected);
+				CHECK(lazyImageLayer.getChannelRegion(lazyChannel.m_ChannelID.id, region) == expected);
+
+				const ChannelRegion fullRegion(0, 0, width, height);
+				CHECK(lazyChannel.getRegion<T>(fullRegion) == eagerChannel.getData<T>());
+				CHECK(eagerChannel.getRegion<T>(fullRegion) == eagerChannel.getData<T>());
+			});
+	}
+}
+
+
+TEST_CASE("Read channel regions")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path documents = std::filesystem::current_path();
+	documents += "/documents/Compression/";
+
+	SUBCASE("RLE PSD")
+	{
+		compareRegions<bpp8_t>(documents / "Compression_RLE_8bit.psd");
+	}
+	SUBCASE("RLE PSB")
+	{
+		compareRegions<bpp8_t>(documents / "Compression_RLE_8bit.psb");
+	}
+	SUBCASE("Raw")
+	{
+		compareRegions<bpp8_t>(documents / "Compression_RAW_8bit.psd");
+	}
+	SUBCASE("Mixed")
+	{
+		compareRegions<bpp8_t>(documents / "Compression_Mixed_8bit.psd");
+	}
+	SUBCASE("ZipPrediction 16-bit")
+	{
+		compareRegions<bpp16_t>(documents / "Compression_ZipPrediction_16bit.psb");
+	}
+	SUBCASE("ZipPrediction 32-bit")
+	{
+		compareRegions<bpp32_t>(documents / "Compression_ZipPrediction_32bit.psd");
+	}
+}
+
+
+TEST_CASE("Read channel region of a mask")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Masks/Masks_8bit.psd";
+
+	File::FileParams params;
+	params.lazyChannels = true;
+	ProgressCallback callback{};
+	LayeredFile<bpp8_t> eager = LayeredFile<bpp8_t>::read(psd_path);
+	LayeredFile<bpp8_t> lazy = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+
+	auto eagerLayers = eager.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	auto lazyLayers = lazy.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	for (size_t i = 0; i < eagerLayers.size(); ++i)
+	{
+		if (!eagerLayers[i]->m_LayerMask.has_value())
+		{
+			continue;
+		}
+		auto& mask = eagerLayers[i]->m_LayerMask->maskData;
+		const ChannelRegion region(mask->getWidth() / 4, mask->getHeight() / 4, mask->getWidth() / 2, mask->getHeight() / 2);
+		const std::vector<bpp8_t> expected = cropRegion(mask->getData<bpp8_t>(), mask->getWidth(), region);
+		CHECK(lazyLayers[i]->m_LayerMask->maskData->getRegion<bpp8_t>(region) == expected);
+	}
+}
+
+
+TEST_CASE("Reading an RLE region only reads the rows it covers")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Compression/Compression_RLE_8bit.psd";
+	std::vector<uint8_t> data = readBytes(psd_path);
+
+	std::atomic<uint64_t> bytesRead = 0u;
+	auto source = std::make_unique<CallbackByteSource>([&](char* buffer, const uint64_t offset, const uint64_t size)
+		{
+			std::memcpy(buffer, data.data() + offset, size);
+			bytesRead += size;
+		}, data.size());
+	File document(std::move(source));
+	document.setLazyChannels(true);
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(document);
+
+	auto layer = std::dynamic_pointer_cast<ImageLayer<bpp8_t>>(layeredFile.generateFlatLayers(std::nullopt, LayerOrder::forward).at(0));
+	REQUIRE(layer);
+	auto& channel = layer->m_ImageData.begin()->second;
+	REQUIRE(channel->m_Compression == Enum::Compression::Rle);
+	REQUIRE(channel->getHeight() > 4);
+
+	bytesRead = 0u;
+	channel->getRegion<bpp8_t>(ChannelRegion(0, 0, channel->getWidth(), 2));
+	const uint64_t regionBytes = bytesRead.exchange(0u);
+	channel->getData<bpp8_t>();
+	const uint64_t channelBytes = bytesRead.load();
+	CHECK(regionBytes < channelBytes);
+
+	CHECK_THROWS(channel->getRegion<bpp8_t>(ChannelRegion(1, 0, channel->getWidth(), 1)));
+}
@@ -0,0 +1,82 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "PhotoshopFile/PhotoshopFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+
+TEST_CASE("Residency hints are issued for every layer")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	SUBCASE("Enabled")
+	{
+		File::FileParams params = {};
+		params.adviseResidency = true;
+		params.prefetchLayers = 2u;
+		File document(psd_path, params);
+		ProgressCallback callback{};
+		PhotoshopFile photoshopFile;
+		photoshopFile.read(document, callback);
+
+		const auto& layerInfo = photoshopFile.m_LayerMaskInfo.m_LayerInfo;
+		File::ResidencyCounters counters = document.getResidencyCounters();
+		// Every layer gets prefetched exactly once, either up front or when the layer before it is decoded
+		CHECK(counters.prefetchCount == layerInfo.m_LayerRecords.size());
+		CHECK(counters.prefetchBytes <= document.getSize());
+		// Only whole pages are ever released, so small layers might not release anything
+		CHECK(counters.releaseBytes <= document.getSize());
+	}
+
+	SUBCASE("Disabled")
+	{
+		File document(psd_path);
+		ProgressCallback callback{};
+		PhotoshopFile photoshopFile;
+		photoshopFile.read(document, callback);
+
+		File::ResidencyCounters counters = document.getResidencyCounters();
+		CHECK(counters.prefetchCount == 0u);
+		CHECK(counters.releaseCount == 0u);
+	}
+}
+
+
+TEST_CASE("Release whole pages of a mapped file")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path path = std::filesystem::current_path();
+	path += "/documents/Write/Residency.bin";
+	std::filesystem::create_directories(path.parent_path());
+	{
+		std::ofstream stream(path, std::ios::binary);
+		std::vector<char> data(1024u * 1024u, 1);
+		stream.write(data.data(), data.size());
+	}
+
+	File document(path);
+	document.setResidencyHints(true);
+	document.advise(0u, document.getSize(), ByteSource::Advice::WillNeed);
+	document.advise(0u, document.getSize(), ByteSource::Advice::DontNeed);
+	// A range too small to cover a whole page is never released
+	document.advise(10u, 20u, ByteSource::Advice::DontNeed);
+
+	File::ResidencyCounters counters = document.getResidencyCounters();
+	CHECK(counters.prefetchCount == 1u);
+	CHECK(counters.prefetchBytes == document.getSize());
+	CHECK(counters.releaseCount == 1u);
+	CHECK(counters.releaseBytes == document.getSize());
+
+	// The data is faulted back in after being released
+	uint8_t value = 0u;
+	document.read(reinterpret_cast<char*>(&value), 1u);
+	CHECK(value == 1u);
+}
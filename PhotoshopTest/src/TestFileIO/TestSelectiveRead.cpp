@@ -0,0 +1,153 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "Core/Struct/LayerFilter.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	// Collect the paths of all image layers whose channels hold image data
+	template <typename T>
+	std::vector<std::string> decodedLayers(NAMESPACE_PSAPI::LayeredFile<T>& layeredFile)
+	{
+		using namespace NAMESPACE_PSAPI;
+
+		std::vector<std::string> paths;
+		std::function<void(const std::vector<std::shared_ptr<Layer<T>>>&, const std::string&)> collect =
+			[&](const std::vector<std::shared_ptr<Layer<T>>>& layers, const std::string& parentPath)
+			{
+				for (const auto& layer : layers)
+				{
+					const std::string path = parentPath + layer->m_LayerName;
+					if (auto groupLayer = std::dynamic_pointer_cast<GroupLayer<T>>(layer))
+					{
+						collect(groupLayer->m_Layers, path + "/");
+					}
+					else if (auto imageLayer = std::dynamic_pointer_cast<ImageLayer<T>>(layer))
+					{
+						for (const auto& [key, value] : imageLayer->m_ImageData)
+						{
+							if (value->hasImageData())
+							{
+								paths.push_back(path);
+								break;
+							}
+						}
+					}
+				}
+			};
+		collect(layeredFile.m_Layers, "");
+		return paths;
+	}
+}
+
+
+TEST_CASE("Glob matching of layer paths")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	CHECK(LayerFilter::matchesGlob("Layer", "Layer"));
+	CHECK_FALSE(LayerFilter::matchesGlob("Layer", "Layer 2"));
+	CHECK(LayerFilter::matchesGlob("Layer*", "Layer 2"));
+	CHECK(LayerFilter::matchesGlob("Layer ?", "Layer 2"));
+	CHECK(LayerFilter::matchesGlob("Group/*", "Group/Layer"));
+	CHECK_FALSE(LayerFilter::matchesGlob("Group/*", "Group/Nested/Layer"));
+	CHECK_FALSE(LayerFilter::matchesGlob("*", "Group/Layer"));
+	CHECK(LayerFilter::matchesGlob("Group/**", "Group/Nested/Layer"));
+	CHECK(LayerFilter::matchesGlob("**/Layer", "Group/Nested/Layer"));
+	CHECK_FALSE(LayerFilter::matchesGlob("Group?Layer", "Group/Layer"));
+}
+
+
+TEST_CASE("Selectively read layers by path")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	LayerFilter filter;
+	filter.m_Paths = { "GroupTopLevel/CollapsedGroup/*" };
+	ProgressCallback callback{};
+
+	SUBCASE("Eager")
+	{
+		LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(psd_path, filter, callback);
+		std::vector<std::string> decoded = decodedLayers(layeredFile);
+		REQUIRE(decoded.size() > 0);
+		for (const auto& path : decoded)
+		{
+			CHECK(LayerFilter::matchesGlob(filter.m_Paths[0], path));
+		}
+
+		// The hierarchy stays intact and the selected layers decode the same as a full read
+		LayeredFile<bpp8_t> full = LayeredFile<bpp8_t>::read(psd_path);
+		CHECK(layeredFile.generateFlatLayers(std::nullopt, LayerOrder::forward).size() == full.generateFlatLayers(std::nullopt, LayerOrder::forward).size());
+		auto selected = findLayerAs<bpp8_t, ImageLayer>("GroupTopLevel/CollapsedGroup/BlackLayer", layeredFile);
+		auto reference = findLayerAs<bpp8_t, ImageLayer>("GroupTopLevel/CollapsedGroup/BlackLayer", full);
+		REQUIRE(selected);
+		REQUIRE(reference);
+		CHECK(selected->getImageData() == reference->getImageData());
+	}
+	SUBCASE("Lazy")
+	{
+		File::FileParams params;
+		params.layerFilter = filter;
+		params.lazyChannels = true;
+		LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(psd_path, params, callback);
+		std::vector<std::string> decoded = decodedLayers(layeredFile);
+		REQUIRE(decoded.size() > 0);
+		for (const auto& path : decoded)
+		{
+			CHECK(LayerFilter::matchesGlob(filter.m_Paths[0], path));
+		}
+	}
+	SUBCASE("Stream")
+	{
+		std::ifstream stream(psd_path, std::ios::binary);
+		File document(std::make_unique<StreamByteSource>(stream));
+		document.setLayerFilter(filter);
+		LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(document);
+		std::vector<std::string> decoded = decodedLayers(layeredFile);
+		REQUIRE(decoded.size() > 0);
+		for (const auto& path : decoded)
+		{
+			CHECK(LayerFilter::matchesGlob(filter.m_Paths[0], path));
+		}
+	}
+}
+
+
+TEST_CASE("Selectively read layers by predicate and channel")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_16bit.psd";
+
+	LayerFilter filter;
+	filter.m_Predicate = [](const LayerRecord& layerRecord, const std::string& path) { return path.ends_with("BlackLayer"); };
+	filter.m_Channels = { Enum::ChannelIDInfo{ Enum::ChannelID::Red, 0 } };
+	ProgressCallback callback{};
+	LayeredFile<bpp16_t> layeredFile = LayeredFile<bpp16_t>::read(psd_path, filter, callback);
+	LayeredFile<bpp16_t> full = LayeredFile<bpp16_t>::read(psd_path);
+
+	auto selected = findLayerAs<bpp16_t, ImageLayer>("GroupTopLevel/CollapsedGroup/BlackLayer", layeredFile);
+	auto reference = findLayerAs<bpp16_t, ImageLayer>("GroupTopLevel/CollapsedGroup/BlackLayer", full);
+	REQUIRE(selected);
+	REQUIRE(reference);
+	for (const auto& [key, value] : selected->m_ImageData)
+	{
+		CHECK(value->hasImageData() == (key.id == Enum::ChannelID::Red));
+		CHECK(value->m_Compression == reference->m_ImageData.at(key)->m_Compression);
+	}
+	CHECK(selected->getChannel(Enum::ChannelID::Red) == reference->getChannel(Enum::ChannelID::Red));
+}
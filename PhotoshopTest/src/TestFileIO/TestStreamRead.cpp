@@ -0,0 +1,177 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Struct/File.h"
+#include "LayeredFile/LayeredFile.h"
+#include "../TestHelpers.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+	// Stand-in for a pipe handing out the data in small chunks, keeping track of how much was consumed
+	struct ChunkedStream
+	{
+		std::vector<uint8_t> m_Data;
+		uint64_t m_Position = 0u;
+		uint64_t m_ChunkSize = 1024u;
+
+		NAMESPACE_PSAPI::StreamByteSource::ReadFunction readFunction()
+		{
+			return [this](char* buffer, const uint64_t size) -> uint64_t
+				{
+					const uint64_t toRead = std::min({ size, m_ChunkSize, m_Data.size() - m_Position });
+					std::memcpy(buffer, m_Data.data() + m_Position, toRead);
+					m_Position += toRead;
+					return toRead;
+				};
+		}
+	};
+}
+
+
+TEST_CASE("Read LayeredFile from a non-seekable stream")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	LayeredFile<bpp8_t> fromDisk = LayeredFile<bpp8_t>::read(psd_path);
+
+	ChunkedStream stream;
+	stream.m_Data = readBytes(psd_path);
+	auto source = std::make_unique<StreamByteSource>(stream.readFunction());
+	StreamByteSource* sourcePtr = source.get();
+	File document(std::move(source));
+	LayeredFile<bpp8_t> fromStream = LayeredFile<bpp8_t>::read(document);
+
+	compareImageData(fromDisk, fromStream);
+	// We never needed to hold on to the whole document
+	CHECK(sourcePtr->getBufferHighWaterMark() < stream.m_Data.size());
+	CHECK(stream.m_Position <= stream.m_Data.size());
+}
+
+
+TEST_CASE("Read LayeredFile from a non-seekable stream without buffering the channel image data")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Compression/Compression_Mixed_8bit.psd";
+
+	LayeredFile<bpp8_t> fromDisk = LayeredFile<bpp8_t>::read(psd_path);
+
+	ChunkedStream stream;
+	stream.m_Data = readBytes(psd_path);
+	auto source = std::make_unique<StreamByteSource>(stream.readFunction());
+	StreamByteSource* sourcePtr = source.get();
+	File document(std::move(source));
+	LayeredFile<bpp8_t> fromStream = LayeredFile<bpp8_t>::read(document);
+
+	compareImageData(fromDisk, fromStream);
+	// The layers are read one at a time straight into their own buffers so the source only ever held on to a small
+	// window of the stream rather than a copy of the channel image data
+	CHECK(sourcePtr->getBufferHighWaterMark() <= 2u * 1024u * 64u);
+}
+
+
+TEST_CASE("Read LayeredFile from a std::istream")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_16bit.psb";
+
+	LayeredFile<bpp16_t> fromDisk = LayeredFile<bpp16_t>::read(psd_path);
+
+	std::ifstream stream(psd_path, std::ios::binary);
+	File document(std::make_unique<StreamByteSource>(stream));
+	LayeredFile<bpp16_t> fromStream = LayeredFile<bpp16_t>::read(document);
+
+	compareImageData(fromDisk, fromStream);
+}
+
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("Read LayeredFile from a pipe")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+
+	LayeredFile<bpp8_t> fromDisk = LayeredFile<bpp8_t>::read(psd_path);
+	std::vector<uint8_t> data = readBytes(psd_path);
+
+	int fileDescriptors[2];
+	REQUIRE(::pipe(fileDescriptors) == 0);
+	std::thread writer([&]()
+		{
+			uint64_t written = 0u;
+			while (written < data.size())
+			{
+				ssize_t result = ::write(fileDescriptors[1], data.data() + written, data.size() - written);
+				if (result <= 0)
+				{
+					break;
+				}
+				written += static_cast<uint64_t>(result);
+			}
+			::close(fileDescriptors[1]);
+		});
+
+	{
+		File document(std::make_unique<StreamByteSource>(fileDescriptors[0]));
+		LayeredFile<bpp8_t> fromPipe = LayeredFile<bpp8_t>::read(document);
+
+		compareImageData(fromDisk, fromPipe);
+	}
+	// Drain whatever we did not need (the merged image data) so the writer can finish
+	std::vector<char> scratch(4096u);
+	while (::read(fileDescriptors[0], scratch.data(), scratch.size()) > 0) {}
+	writer.join();
+	::close(fileDescriptors[0]);
+}
+#endif
+
+
+TEST_CASE("Stream source rejects reading released data")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	ChunkedStream stream;
+	stream.m_Data.resize(1024u * 512u);
+	for (size_t i = 0; i < stream.m_Data.size(); ++i)
+	{
+		stream.m_Data[i] = static_cast<uint8_t>(i * 13u);
+	}
+	StreamByteSource source(stream.readFunction(), stream.m_Data.size(), 1024u);
+
+	std::vector<char> buffer(256u);
+	source.read(buffer.data(), 1024u * 256u, buffer.size());
+	CHECK(std::memcmp(buffer.data(), stream.m_Data.data() + 1024u * 256u, buffer.size()) == 0);
+	// The skipped region was consumed but never buffered
+	CHECK(source.getBufferHighWaterMark() <= buffer.size());
+
+	// Small jumps backwards are fine while larger ones are an error
+	std::vector<char> largeBuffer(2048u);
+	source.read(largeBuffer.data(), 1024u * 256u + buffer.size(), largeBuffer.size());
+	source.read(buffer.data(), 1024u * 256u + 1536u, buffer.size());
+	CHECK(std::memcmp(buffer.data(), stream.m_Data.data() + 1024u * 256u + 1536u, buffer.size()) == 0);
+	CHECK_THROWS(source.read(buffer.data(), 1024u * 128u, buffer.size()));
+
+	// Reading past the end of the stream is an error as well
+	CHECK_THROWS(source.read(buffer.data(), stream.m_Data.size() - 128u, buffer.size()));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "doctest.h"
+
+#include "Macros.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+
+// Read the whole file into memory, e.g. to serve it from an in-memory source
+inline std::vector<uint8_t> readBytes(const std::filesystem::path& path)
+{
+	std::ifstream stream(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+
+// Walk the layers of both files in the same order and call compareChannel(expectedChannel, actualChannel, actualLayer)
+// for every channel of the expected image layers with the channel of the same id on the actual layer
+template <typename T, typename CompareChannel>
+void compareImageData(NAMESPACE_PSAPI::LayeredFile<T>& expected, NAMESPACE_PSAPI::LayeredFile<T>& actual, CompareChannel compareChannel)
+{
+	using namespace NAMESPACE_PSAPI;
+
+	auto expectedLayers = expected.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	auto actualLayers = actual.generateFlatLayers(std::nullopt, LayerOrder::forward);
+	REQUIRE(expectedLayers.size() == actualLayers.size());
+	for (size_t i = 0; i < expectedLayers.size(); ++i)
+	{
+		CHECK(expectedLayers[i]->m_LayerName == actualLayers[i]->m_LayerName);
+
+		auto expectedImageLayer = std::dynamic_pointer_cast<ImageLayer<T>>(expectedLayers[i]);
+		auto actualImageLayer = std::dynamic_pointer_cast<ImageLayer<T>>(actualLayers[i]);
+		REQUIRE((expectedImageLayer == nullptr) == (actualImageLayer == nullptr));
+		if (!expectedImageLayer)
+		{
+			continue;
+		}
+		REQUIRE(expectedImageLayer->m_ImageData.size() == actualImageLayer->m_ImageData.size());
+		for (auto& [key, value] : expectedImageLayer->m_ImageData)
+		{
+			compareChannel(*value, *actualImageLayer->m_ImageData.at(key), *actualImageLayer);
+		}
+	}
+}
+
+
+// Check that both files hold the same image data for all of their layers
+template <typename T>
+void compareImageData(NAMESPACE_PSAPI::LayeredFile<T>& expected, NAMESPACE_PSAPI::LayeredFile<T>& actual)
+{
+	compareImageData(expected, actual, [](NAMESPACE_PSAPI::ImageChannel& expectedChannel, NAMESPACE_PSAPI::ImageChannel& actualChannel, NAMESPACE_PSAPI::ImageLayer<T>&)
+		{
+			CHECK(actualChannel.getData<T>() == expectedChannel.getData<T>());
+		});
+}
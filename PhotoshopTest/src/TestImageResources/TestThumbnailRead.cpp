@@ -0,0 +1,155 @@
+#include "doctest.h"
+
+#include "PhotoshopFile/PhotoshopFile.h"
+#include "Core/FileIO/Read.h"
+#include "Core/Struct/ByteSink.h"
+#include "Core/Struct/ByteSource.h"
+#include "Core/Struct/ResourceBlock.h"
+#include "Macros.h"
+#include "../TestHelpers.h"
+
+#include <filesystem>
+#include <vector>
+
+
+namespace
+{
+	uint32_t readUInt32BE(const std::vector<uint8_t>& data, const uint64_t offset)
+	{
+		return (static_cast<uint32_t>(data[offset]) << 24u) | (static_cast<uint32_t>(data[offset + 1]) << 16u) |
+			(static_cast<uint32_t>(data[offset + 2]) << 8u) | static_cast<uint32_t>(data[offset + 3]);
+	}
+}
+
+
+TEST_CASE("Read the thumbnail of a document")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path documents = std::filesystem::current_path();
+	documents += "/documents/";
+
+	SUBCASE("PSD")
+	{
+		auto thumbnail = PhotoshopFile::readThumbnail(documents / "Compression/Compression_Mixed_8bit.psd");
+		REQUIRE(thumbnail.has_value());
+		CHECK(thumbnail->m_Format == Enum::ThumbnailFormat::JpegRGB);
+		CHECK(thumbnail->m_Width == 128u);
+		CHECK(thumbnail->m_Height == 72u);
+		CHECK(thumbnail->m_WidthBytes == 384u);
+		CHECK(thumbnail->m_BitsPerPixel == 24u);
+		REQUIRE(thumbnail->m_Data.size() == 2028u);
+		// A complete JFIF file from the start of image to the end of image marker
+		CHECK(thumbnail->m_Data[0] == 0xFFu);
+		CHECK(thumbnail->m_Data[1] == 0xD8u);
+		CHECK(thumbnail->m_Data[thumbnail->m_Data.size() - 2] == 0xFFu);
+		CHECK(thumbnail->m_Data[thumbnail->m_Data.size() - 1] == 0xD9u);
+	}
+	SUBCASE("PSB")
+	{
+		auto thumbnail = PhotoshopFile::readThumbnail(documents / "SingleLayer/SingleLayer_32bit.psb");
+		REQUIRE(thumbnail.has_value());
+		CHECK(thumbnail->m_Width == 64u);
+		CHECK(thumbnail->m_Height == 64u);
+		CHECK(thumbnail->m_Data.size() == 614u);
+	}
+}
+
+
+TEST_CASE("Reading the thumbnail does not touch the layer and mask information")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+	std::vector<uint8_t> data = readBytes(psd_path);
+	auto expected = PhotoshopFile::readThumbnail(psd_path);
+	REQUIRE(expected.has_value());
+
+	// Cut the document off right after the image resources section
+	const uint64_t colorModeDataOffset = 26u;
+	const uint64_t imageResourcesOffset = colorModeDataOffset + 4u + readUInt32BE(data, colorModeDataOffset);
+	const uint64_t layerAndMaskInfoOffset = imageResourcesOffset + 4u + readUInt32BE(data, imageResourcesOffset);
+	data.resize(layerAndMaskInfoOffset);
+
+	File document(std::make_unique<MemoryByteSource>(std::move(data)));
+	auto thumbnail = PhotoshopFile::readThumbnail(document);
+	REQUIRE(thumbnail.has_value());
+	CHECK(thumbnail->m_Data == expected->m_Data);
+	CHECK(document.getOffset() == layerAndMaskInfoOffset);
+}
+
+
+TEST_CASE("Roundtrip a thumbnail block")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	// Raw thumbnails are stored with their rows padded to 4 bytes
+	std::vector<uint8_t> pixels(16u * 3u, 127u);
+	ThumbnailBlock block(Enum::ThumbnailFormat::RawRGB, 5u, 3u, std::vector<uint8_t>(pixels));
+	CHECK(block.m_WidthBytes == 16u);
+	CHECK_THROWS(ThumbnailBlock(Enum::ThumbnailFormat::RawRGB, 5u, 3u, std::vector<uint8_t>(5u * 3u * 3u)));
+
+	auto sink = std::make_unique<MemoryByteSink>();
+	MemoryByteSink* sinkPtr = sink.get();
+	File document(std::move(sink));
+	block.write(document);
+	document.flush();
+	std::vector<uint8_t> bytes = sinkPtr->release();
+	CHECK(bytes.size() == block.m_Size);
+
+	File readDocument(std::make_unique<MemoryByteSource>(std::move(bytes)));
+	CHECK(ReadBinaryData<uint32_t>(readDocument) == Signature("8BIM").m_Value);
+	CHECK(ReadBinaryData<uint16_t>(readDocument) == 1036u);
+	ThumbnailBlock readBlock;
+	CHECK(readBlock.read(readDocument, 0u));
+	CHECK(readBlock.m_Format == Enum::ThumbnailFormat::RawRGB);
+	CHECK(readBlock.m_Width == 5u);
+	CHECK(readBlock.m_Height == 3u);
+	CHECK(readBlock.m_Size == block.m_Size);
+	CHECK(readBlock.m_Data == pixels);
+	CHECK(readDocument.getOffset() == readDocument.getSize());
+}
+
+
+TEST_CASE("A malformed thumbnail is skipped")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path psd_path = std::filesystem::current_path();
+	psd_path += "/documents/Groups/Groups_8bit.psd";
+	std::vector<uint8_t> data = readBytes(psd_path);
+
+	// Locate the thumbnail resource and overwrite its format with one we do not know about
+	const uint64_t colorModeDataOffset = 26u;
+	const uint64_t imageResourcesOffset = colorModeDataOffset + 4u + readUInt32BE(data, colorModeDataOffset);
+	const uint64_t imageResourcesEnd = imageResourcesOffset + 4u + readUInt32BE(data, imageResourcesOffset);
+	uint64_t offset = imageResourcesOffset + 4u;
+	bool found = false;
+	while (offset < imageResourcesEnd)
+	{
+		const uint16_t uniqueID = static_cast<uint16_t>((data[offset + 4u] << 8u) | data[offset + 5u]);
+		// Pascal string padded to an even size including its length byte
+		const uint64_t nameSize = (static_cast<uint64_t>(data[offset + 6u]) + 2u) & ~uint64_t{ 1u };
+		const uint64_t dataOffset = offset + 6u + nameSize + 4u;
+		if (uniqueID == 1036u)
+		{
+			data[dataOffset + 3u] = 7u;
+			found = true;
+			break;
+		}
+		offset = dataOffset + ((readUInt32BE(data, dataOffset - 4u) + 1u) & ~uint32_t{ 1u });
+	}
+	REQUIRE(found);
+
+	// The rest of the document is still read
+	File document(std::make_unique<MemoryByteSource>(std::vector<uint8_t>(data)));
+	PhotoshopFile photoshopFile;
+	ProgressCallback callback{};
+	CHECK_NOTHROW(photoshopFile.read(document, callback));
+	CHECK(photoshopFile.m_LayerMaskInfo.m_LayerInfo.m_LayerRecords.size() > 0u);
+
+	File thumbnailDocument(std::make_unique<MemoryByteSource>(std::move(data)));
+	CHECK_FALSE(PhotoshopFile::readThumbnail(thumbnailDocument).has_value());
+	CHECK(thumbnailDocument.getOffset() == imageResourcesEnd);
+}
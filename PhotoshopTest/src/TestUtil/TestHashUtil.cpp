@@ -0,0 +1,43 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Util/HashUtil.h"
+
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	uint64_t hashString(const std::string& value)
+	{
+		return NAMESPACE_PSAPI::hash64(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(value.data()), value.size()));
+	}
+}
+
+
+TEST_CASE("Hash matches the XXH64 reference values")
+{
+	CHECK(hashString("") == 0xEF46DB3751D8E999ull);
+	CHECK(hashString("abc") == 0x44BC2CF5AD770999ull);
+	// Long enough to go through the 32 byte stripes as well as all of the tail cases
+	CHECK(hashString("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ull);
+}
+
+
+TEST_CASE("Hash depends on every byte and the seed")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::vector<uint8_t> data(1000u, 0u);
+	const uint64_t hash = hash64(data);
+	CHECK(hash64(data) == hash);
+	CHECK(hash64(data, 1u) != hash);
+	for (const size_t index : { size_t{ 0u }, size_t{ 31u }, size_t{ 500u }, size_t{ 999u } })
+	{
+		std::vector<uint8_t> modified = data;
+		modified[index] = 1u;
+		CHECK(hash64(modified) != hash);
+	}
+	CHECK(hash64(std::span<const uint8_t>(data.data(), 999u)) != hash);
+}